@@ -0,0 +1,185 @@
+// A small command line program that compares the scalar and the vectorised mid/side kernels:
+// how long each one takes per sample, and how far apart their results are.
+//
+// The kernel includes "../JuceLibraryCode/JuceHeader.h" relative to its own folder, which only exists once the plug-in
+// has been saved in the Projucer. The exporters of this project add Benchmark/Source to the header search paths, so that
+// otherwise the same include finds the JuceLibraryCode of this project.
+//
+// Build the Release configuration, the numbers of a Debug build say nothing about the real cost.
+// The program returns 1 if the vectorised kernels differ from the scalar ones by more than the tolerance.
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/MidSideKernel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+namespace
+{
+    const int blockSize = 512;
+    const int numBlocks = 20000;
+    const int numTimingRuns = 5;            // the fastest run is reported, the others are disturbed by something else
+
+    // MidSideKernel.h promises bit-exact results, or one rounding step apart if the compiler uses FMA for the scalar loop
+    const float tolerance = 1e-6f;
+
+    struct Timing
+    {
+        double nanosecondsPerSample = 1e9;
+        double cyclesPerSample = 1e9;
+    };
+
+    // The time stamp counter counts the reference cycles of the CPU. It doesn't follow turbo boost, but it's the
+    // closest thing to a cycle count that we get without special permissions.
+    uint64_t readCycleCounter()
+    {
+       #if JUCE_INTEL
+        return (uint64_t) __rdtsc();
+       #else
+        return 0;
+       #endif
+    }
+
+    // A stereo block of full scale noise. The channels are allocated with some room, so that they can be offset from the
+    // aligned start to test the scalar head and the fallback for channels that can't be aligned at the same time.
+    struct StereoBlock
+    {
+        StereoBlock()
+        {
+            leftStorage.resize((size_t) (blockSize + 64));
+            rightStorage.resize((size_t) (blockSize + 64));
+        }
+
+        void fill(unsigned int seed, int leftOffset, int rightOffset)
+        {
+            left = dsp::SIMDRegister<float>::getNextSIMDAlignedPtr(leftStorage.data()) + leftOffset;
+            right = dsp::SIMDRegister<float>::getNextSIMDAlignedPtr(rightStorage.data()) + rightOffset;
+
+            std::mt19937 generator(seed);
+            std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+            for (int i = 0; i < blockSize; i++)
+            {
+                left[i] = distribution(generator);
+                right[i] = distribution(generator);
+            }
+        }
+
+        std::vector<float> leftStorage, rightStorage;
+        float* left = nullptr;
+        float* right = nullptr;
+    };
+
+    float getMaxDifference(const StereoBlock& a, const StereoBlock& b)
+    {
+        float maxDifference = 0;
+
+        for (int i = 0; i < blockSize; i++)
+            maxDifference = jmax(maxDifference, std::abs(a.left[i] - b.left[i]), std::abs(a.right[i] - b.right[i]));
+
+        return maxDifference;
+    }
+
+    // Runs the kernel on the same block over and over. The input is copied back before each call, outside of the timed
+    // part, otherwise the gains would make the samples grow without end or decay into denormals.
+    template <typename Kernel>
+    Timing time(Kernel kernel)
+    {
+        Timing timing;
+        StereoBlock input, block;
+        input.fill(1, 0, 0);
+        block.fill(1, 0, 0);
+
+        for (int run = 0; run < numTimingRuns; run++)
+        {
+            std::chrono::nanoseconds elapsed(0);
+            uint64_t cycles = 0;
+
+            for (int i = 0; i < numBlocks; i++)
+            {
+                std::copy(input.left, input.left + blockSize, block.left);
+                std::copy(input.right, input.right + blockSize, block.right);
+
+                const auto startTime = std::chrono::high_resolution_clock::now();
+                const uint64_t startCycles = readCycleCounter();
+
+                kernel(block.left, block.right, blockSize);
+
+                cycles += readCycleCounter() - startCycles;
+                elapsed += std::chrono::high_resolution_clock::now() - startTime;
+            }
+
+            const double numSamples = (double) numBlocks * blockSize;
+            timing.nanosecondsPerSample = jmin(timing.nanosecondsPerSample, (double) elapsed.count() / numSamples);
+            timing.cyclesPerSample = jmin(timing.cyclesPerSample, (double) cycles / numSamples);
+        }
+
+        return timing;
+    }
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+    const float midGain = 0.7f, sideGain = 0.3f;
+    const float startSideGain = 0.2f, endSideGain = 0.9f;
+
+    auto constantScalar = [=] (float* l, float* r, int n) { processMidSideWidthScalar(l, r, n, midGain, sideGain); };
+    auto constantVector = [=] (float* l, float* r, int n) { processMidSideWidth(l, r, n, midGain, sideGain); };
+
+    // The same gains that processMidSideWidthRamp calculates for its scalar parts
+    auto rampScalar = [=] (float* l, float* r, int n)
+    {
+        const float increment = (endSideGain - startSideGain) / (float) n;
+        processMidSideWidthRampScalar(l, r, 0, n, startSideGain + increment, increment);
+    };
+    auto rampVector = [=] (float* l, float* r, int n) { processMidSideWidthRamp(l, r, n, startSideGain, endSideGain); };
+
+    // Aligned channels, both channels one sample after the alignment, and channels that can't be aligned together
+    const int offsets[][2] = { { 0, 0 }, { 1, 1 }, { 0, 1 } };
+
+    float maxConstantDifference = 0, maxRampDifference = 0;
+
+    for (auto& offset : offsets)
+    {
+        StereoBlock scalar, vectorised;
+
+        scalar.fill(2, offset[0], offset[1]);
+        vectorised.fill(2, offset[0], offset[1]);
+        constantScalar(scalar.left, scalar.right, blockSize);
+        constantVector(vectorised.left, vectorised.right, blockSize);
+        maxConstantDifference = jmax(maxConstantDifference, getMaxDifference(scalar, vectorised));
+
+        scalar.fill(3, offset[0], offset[1]);
+        vectorised.fill(3, offset[0], offset[1]);
+        rampScalar(scalar.left, scalar.right, blockSize);
+        rampVector(vectorised.left, vectorised.right, blockSize);
+        maxRampDifference = jmax(maxRampDifference, getMaxDifference(scalar, vectorised));
+    }
+
+    const Timing timings[] = { time(constantScalar), time(constantVector), time(rampScalar), time(rampVector) };
+    const char* names[] = { "constant, scalar", "constant, SIMD", "ramp, scalar", "ramp, SIMD" };
+
+    std::printf("%-18s %14s %14s\n", "", "ns/sample", "cycles/sample");
+
+    for (int i = 0; i < 4; i++)
+        std::printf("%-18s %14.3f %14.2f\n", names[i], timings[i].nanosecondsPerSample, timings[i].cyclesPerSample);
+
+    std::printf("\nmax difference, constant: %g\nmax difference, ramp:     %g\n", maxConstantDifference, maxRampDifference);
+
+    const bool ok = maxConstantDifference <= tolerance && maxRampDifference <= tolerance;
+    if (ok)
+        std::printf("OK\n");
+    else
+        std::printf("FAILED: the vectorised kernels differ from the scalar ones by more than %g\n", tolerance);
+
+    return ok ? 0 : 1;
+}
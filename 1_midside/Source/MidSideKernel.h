@@ -0,0 +1,157 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// The mid/side width kernel of the plug-in.
+//
+// The processing is the same as it has always been: encode the left and right samples to mid and side,
+// apply the gains to mid and side, and decode back to left and right. The only difference is that the vectorised
+// version processes several samples with a single instruction.
+//
+// For the vectorisation we use juce::dsp::SIMDRegister. A SIMDRegister<float> holds as many floats as the CPU can
+// process at once: 4 with SSE (x86) and NEON (ARM), and 8 with AVX2 if the project is compiled with AVX2 enabled.
+// Arithmetic operators such as + and * are defined for it, so the vectorised code reads just like the scalar code.
+//
+// SIMDRegisters can only be loaded from and stored to aligned memory addresses, so the block is processed in three parts:
+//      1. a scalar head, until the pointers are aligned
+//      2. the vectorised body
+//      3. a scalar tail for the samples that don't fill a whole register
+//
+// Since the vectorised body does exactly the same operations in the same order as the scalar loop, the results are
+// bit-exact. The only exception is a compiler that fuses the scalar multiply-adds into FMA instructions, in which case
+// the results may differ by one rounding step, i.e. less than 1e-6 for full scale signals.
+// The program in Benchmark/ checks that, and measures how much faster the vectorised kernels are.
+//
+// For automation, there's a ramped version of the kernel too. Instead of taking a constant side gain, it moves the
+// side gain linearly from one value to another during the block. The gain for each sample is calculated from the
+// sample index, so both the scalar and the vectorised parts of the block get exactly the same gains.
+
+
+// The scalar version of the kernel. Used for the unaligned parts of the block.
+inline void processMidSideWidthScalar (float* leftChannel, float* rightChannel, int numSamples, float midGain, float sideGain)
+{
+    for (int i = 0; i < numSamples; i++)
+    {
+        // Calculate the mid and side at index i from the left and right sample at index i,
+        // and manipulate them with the width gains
+        const float midSample = (leftChannel[i] + rightChannel[i]) * midGain;
+        const float sideSample = (leftChannel[i] - rightChannel[i]) * sideGain;
+
+        // Convert back to LR representation
+        leftChannel[i] = midSample + sideSample;
+        rightChannel[i] = midSample - sideSample;
+    }
+}
+
+// The vectorised version of the kernel, processes the left and right channels in place.
+inline void processMidSideWidth (float* leftChannel, float* rightChannel, int numSamples, float midGain, float sideGain)
+{
+    using FloatVector = dsp::SIMDRegister<float>;
+    const int numElements = (int) FloatVector::SIMDNumElements;
+
+    // Number of samples before the left channel pointer is aligned
+    const int numHeadSamples = (int) (FloatVector::getNextSIMDAlignedPtr (leftChannel) - leftChannel);
+
+    // If the left and right channels aren't aligned to the same offset, we can't align them both at the same time.
+    // That is rare with the hosts' buffers, but we have to handle it, so just process the whole block with the scalar kernel.
+    if (numHeadSamples >= numSamples || ! FloatVector::isSIMDAligned (rightChannel + numHeadSamples))
+    {
+        processMidSideWidthScalar (leftChannel, rightChannel, numSamples, midGain, sideGain);
+        return;
+    }
+
+    processMidSideWidthScalar (leftChannel, rightChannel, numHeadSamples, midGain, sideGain);
+
+    // Copy the gains to all elements of the registers
+    const FloatVector midGains = FloatVector::expand (midGain);
+    const FloatVector sideGains = FloatVector::expand (sideGain);
+
+    int i = numHeadSamples;
+
+    for (; i + numElements <= numSamples; i += numElements)
+    {
+        const FloatVector leftSamples = FloatVector::fromRawArray (leftChannel + i);
+        const FloatVector rightSamples = FloatVector::fromRawArray (rightChannel + i);
+
+        const FloatVector midSamples = (leftSamples + rightSamples) * midGains;
+        const FloatVector sideSamples = (leftSamples - rightSamples) * sideGains;
+
+        (midSamples + sideSamples).copyToRawArray (leftChannel + i);
+        (midSamples - sideSamples).copyToRawArray (rightChannel + i);
+    }
+
+    // The tail of the block
+    processMidSideWidthScalar (leftChannel + i, rightChannel + i, numSamples - i, midGain, sideGain);
+}
+
+
+// The scalar version of the ramped kernel, processes the samples from startSample up to, but not including, endSample.
+// The side gain of sample i is firstSideGain + i * sideGainIncrement, and the mid gain is 1 - side gain.
+inline void processMidSideWidthRampScalar (float* leftChannel, float* rightChannel, int startSample, int endSample, float firstSideGain, float sideGainIncrement)
+{
+    for (int i = startSample; i < endSample; i++)
+    {
+        const float sideGain = firstSideGain + (float) i * sideGainIncrement;
+        const float midGain = 1.0f - sideGain;
+
+        const float midSample = (leftChannel[i] + rightChannel[i]) * midGain;
+        const float sideSample = (leftChannel[i] - rightChannel[i]) * sideGain;
+
+        leftChannel[i] = midSample + sideSample;
+        rightChannel[i] = midSample - sideSample;
+    }
+}
+
+// The vectorised version of the ramped kernel.
+// The side gain moves from startSideGain towards endSideGain so that the last sample of the block gets endSideGain.
+inline void processMidSideWidthRamp (float* leftChannel, float* rightChannel, int numSamples, float startSideGain, float endSideGain)
+{
+    using FloatVector = dsp::SIMDRegister<float>;
+    const int numElements = (int) FloatVector::SIMDNumElements;
+
+    if (numSamples <= 0)
+        return;
+
+    // The first sample is already one step away from the start value
+    const float increment = (endSideGain - startSideGain) / (float) numSamples;
+    const float firstSideGain = startSideGain + increment;
+
+    const int numHeadSamples = (int) (FloatVector::getNextSIMDAlignedPtr (leftChannel) - leftChannel);
+
+    if (numHeadSamples >= numSamples || ! FloatVector::isSIMDAligned (rightChannel + numHeadSamples))
+    {
+        processMidSideWidthRampScalar (leftChannel, rightChannel, 0, numSamples, firstSideGain, increment);
+        return;
+    }
+
+    processMidSideWidthRampScalar (leftChannel, rightChannel, 0, numHeadSamples, firstSideGain, increment);
+
+    // A register of { 0, 1, 2, 3, ... } that we add to the sample index to get the index of each element
+    FloatVector elementIndices = FloatVector::expand (0.0f);
+    for (int element = 0; element < numElements; element++)
+        elementIndices.set ((size_t) element, (float) element);
+
+    const FloatVector firstSideGains = FloatVector::expand (firstSideGain);
+    const FloatVector increments = FloatVector::expand (increment);
+    const FloatVector ones = FloatVector::expand (1.0f);
+
+    int i = numHeadSamples;
+
+    for (; i + numElements <= numSamples; i += numElements)
+    {
+        const FloatVector sampleIndices = FloatVector::expand ((float) i) + elementIndices;
+        const FloatVector sideGains = firstSideGains + sampleIndices * increments;
+        const FloatVector midGains = ones - sideGains;
+
+        const FloatVector leftSamples = FloatVector::fromRawArray (leftChannel + i);
+        const FloatVector rightSamples = FloatVector::fromRawArray (rightChannel + i);
+
+        const FloatVector midSamples = (leftSamples + rightSamples) * midGains;
+        const FloatVector sideSamples = (leftSamples - rightSamples) * sideGains;
+
+        (midSamples + sideSamples).copyToRawArray (leftChannel + i);
+        (midSamples - sideSamples).copyToRawArray (rightChannel + i);
+    }
+
+    processMidSideWidthRampScalar (leftChannel, rightChannel, i, numSamples, firstSideGain, increment);
+}
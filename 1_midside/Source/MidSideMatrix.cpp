@@ -0,0 +1,86 @@
+#include "MidSideMatrix.h"
+#include "MidSideKernel.h"
+
+std::vector<MidSideMatrix::ChannelPair> MidSideMatrix::findChannelPairs (const AudioChannelSet& layout)
+{
+    // All channel types that have a left/right counterpart. The first one is the main front pair.
+    const AudioChannelSet::ChannelType pairTypes[][2] =
+    {
+        { AudioChannelSet::left,                AudioChannelSet::right },
+        { AudioChannelSet::leftCentre,          AudioChannelSet::rightCentre },
+        { AudioChannelSet::leftSurround,        AudioChannelSet::rightSurround },
+        { AudioChannelSet::leftSurroundSide,    AudioChannelSet::rightSurroundSide },
+        { AudioChannelSet::leftSurroundRear,    AudioChannelSet::rightSurroundRear },
+        { AudioChannelSet::wideLeft,            AudioChannelSet::wideRight },
+        { AudioChannelSet::topFrontLeft,        AudioChannelSet::topFrontRight },
+        { AudioChannelSet::topSideLeft,         AudioChannelSet::topSideRight },
+        { AudioChannelSet::topRearLeft,         AudioChannelSet::topRearRight },
+    };
+
+    std::vector<ChannelPair> foundPairs;
+
+    for (const auto& pairType : pairTypes)
+    {
+        // getChannelIndexForType returns -1 if the layout doesn't have such a channel
+        const int leftChannel = layout.getChannelIndexForType (pairType[0]);
+        const int rightChannel = layout.getChannelIndexForType (pairType[1]);
+
+        if (leftChannel >= 0 && rightChannel >= 0)
+        {
+            const bool isFront = (pairType[0] == AudioChannelSet::left);
+            foundPairs.push_back ({ leftChannel, rightChannel, isFront });
+        }
+    }
+
+    return foundPairs;
+}
+
+void MidSideMatrix::prepare (const AudioChannelSet& layout, double sampleRate, float frontWidth, float surroundWidth)
+{
+    pairs = findChannelPairs (layout);
+    smoothedWidths.resize (pairs.size());
+
+    for (size_t p = 0; p < pairs.size(); p++)
+    {
+        // Start from the current widths, so that we don't fade in from 0
+        smoothedWidths[p].reset (sampleRate, 0.05);
+        smoothedWidths[p].setCurrentAndTargetValue (pairs[p].isFront ? frontWidth : surroundWidth);
+    }
+}
+
+void MidSideMatrix::setWidths (float frontWidth, float surroundWidth)
+{
+    for (size_t p = 0; p < pairs.size(); p++)
+        smoothedWidths[p].setTargetValue (pairs[p].isFront ? frontWidth : surroundWidth);
+}
+
+void MidSideMatrix::process (AudioBuffer<float>& buffer)
+{
+    const int numSamples = buffer.getNumSamples();
+
+    for (size_t p = 0; p < pairs.size(); p++)
+    {
+        float* leftChannel = buffer.getWritePointer (pairs[p].leftChannel);
+        float* rightChannel = buffer.getWritePointer (pairs[p].rightChannel);
+
+        SmoothedValue<float>& smoothedWidth = smoothedWidths[p];
+
+        if (! smoothedWidth.isSmoothing())
+        {
+            // The width has settled, so we can use the same gains for the whole block.
+            // This is the case most of the time, and it costs nothing extra compared to not smoothing at all.
+            const float sideGain = smoothedWidth.getTargetValue();
+            const float midGain = 1.0f - sideGain;
+
+            processMidSideWidth (leftChannel, rightChannel, numSamples, midGain, sideGain);
+        }
+        else
+        {
+            // The width is moving, so ramp the gains linearly from the current value to where the smoother is at the end of the block
+            const float startSideGain = smoothedWidth.getCurrentValue();
+            const float endSideGain = smoothedWidth.skip (numSamples);
+
+            processMidSideWidthRamp (leftChannel, rightChannel, numSamples, startSideGain, endSideGain);
+        }
+    }
+}
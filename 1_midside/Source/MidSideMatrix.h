@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Applies the mid/side width to every left/right channel pair of a channel layout.
+//
+// A stereo layout has just the one pair, but surround layouts such as 5.1 or 7.1.4 have several of them:
+// front left/right, surround left/right, top front left/right and so on. Channels that don't have a pair,
+// such as centre and LFE, are passed through untouched.
+//
+// Mathematically, the processing is a multiplication of the channels with a width matrix. Each pair gets a 2x2 block
+//      [ m+s  m-s ]
+//      [ m-s  m+s ]
+// on the diagonal of the matrix, where m and s are the mid and side gains, and the unpaired channels get a 1.
+// Since all other elements of the matrix are zeros, we don't multiply with the whole matrix, but apply each block to its
+// pair with the vectorised kernel from MidSideKernel.h. This way every sample of the buffer is read and written exactly once.
+class MidSideMatrix
+{
+public:
+
+    // The channel indices of a left/right pair in the buffer
+    struct ChannelPair
+    {
+        int leftChannel;
+        int rightChannel;
+        bool isFront; // true for the main left/right pair, false for surround, height etc. pairs
+    };
+
+    // Find the left/right pairs of a channel layout
+    static std::vector<ChannelPair> findChannelPairs (const AudioChannelSet& layout);
+
+    // Find the channel pairs and prepare the width smoothing. Call this in prepareToPlay().
+    void prepare (const AudioChannelSet& layout, double sampleRate, float frontWidth, float surroundWidth);
+
+    // Set the width of the front pair and the width of all other pairs.
+    // This is called once per block, and the changes are smoothed during the next call to process().
+    void setWidths (float frontWidth, float surroundWidth);
+
+    // Apply the width matrix to the buffer in place
+    void process (AudioBuffer<float>& buffer);
+
+private:
+
+    std::vector<ChannelPair> pairs;
+
+    // One smoother for each pair, so that every pair can have its own width
+    std::vector<SmoothedValue<float>> smoothedWidths;
+};
@@ -17,11 +17,14 @@ MidsideAudioProcessorEditor::MidsideAudioProcessorEditor (MidsideAudioProcessor&
 : AudioProcessorEditor (&p)
 , widthSlider (Slider::RotaryVerticalDrag, Slider::TextBoxBelow) // We can call any of the overloaded constructors that a class provides
 , widthSliderAttachment(*p.widthParameter, widthSlider) // We have to provide the parameter and the slider to the slider attachement. Note the dereferenced parameter with *.
+, surroundWidthSlider (Slider::RotaryVerticalDrag, Slider::TextBoxBelow)
+, surroundWidthSliderAttachment(*p.surroundWidthParameter, surroundWidthSlider)
 , processor (p)
 {
     
     // We have to add the Slider to our parent to make it work
     addAndMakeVisible(widthSlider);
+    addAndMakeVisible(surroundWidthSlider);
     
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
@@ -42,4 +45,5 @@ void MidsideAudioProcessorEditor::resized()
 {
     // We should set bounds to all our children, i.e. the Slider, here
     widthSlider.setBounds(50, 50, 100, 100);
+    surroundWidthSlider.setBounds(200, 50, 100, 100);
 }
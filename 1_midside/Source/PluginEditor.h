@@ -26,6 +26,10 @@ public:
     Slider widthSlider;
     SliderParameterAttachment widthSliderAttachment;
 
+    // The same for the width of the surround pairs
+    Slider surroundWidthSlider;
+    SliderParameterAttachment surroundWidthSliderAttachment;
+
     // 10.
     // This is a reference to the audio processor, to let the gui easily access the audio side of the plug-in.
     // References are a special type of pointers. The difference is, that it can't be nullptr, i.e. the reference has
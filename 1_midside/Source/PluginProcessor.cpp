@@ -37,6 +37,10 @@ MidsideAudioProcessor::MidsideAudioProcessor()
     
     // Add the parameter to the host. The host takes ownership of the parameter, so we don't have to delete its memory on destruction.
     addParameter (widthParameter);
+
+    // With surround layouts, the width of all other channel pairs than the front left/right is controlled with this one
+    surroundWidthParameter = new AudioParameterFloat ("surroundwidthparam", "Surround Width", 0.0f, 1.0f, 0.5f);
+    addParameter (surroundWidthParameter);
 }
 
 // Implementation of the destructor. This will be called, before the plug-in closes. We don't do anything fancy, so the implementation is empty.
@@ -108,6 +112,8 @@ void MidsideAudioProcessor::changeProgramName (int index, const String& newName)
 // We also want to reserve all the memory that our algorithm is going to need.
 void MidsideAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
+    // Find the channel pairs of the layout that the host chose for us, and prepare the width smoothing for them
+    widthMatrix.prepare (getChannelLayoutOfBus (true, 0), sampleRate, widthParameter->get(), surroundWidthParameter->get());
 }
 
 void MidsideAudioProcessor::releaseResources()
@@ -120,13 +126,15 @@ void MidsideAudioProcessor::releaseResources()
 // The host repeatedly asks our plug-in for different layout combinations, and we're supposed to return
 // true if such particular channel and bus layout is supported.
 //
-// Our plug-in is a stereo-in-stereo-out-only plug-in, so that's the only one that we're going to accept:
+// Our plug-in processes left/right channel pairs, so we accept any layout that has at least one such pair, e.g. stereo, 5.1 or 7.1.4.
+// The input and output layouts have to be the same, since the processing is done in place.
 bool MidsideAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
-    const bool inputIsStereo = (layouts.getMainInputChannelSet() == AudioChannelSet::stereo());
-    const bool outputIsStereo = (layouts.getMainOutputChannelSet() == AudioChannelSet::stereo());
+    const AudioChannelSet& inputLayout = layouts.getMainInputChannelSet();
+    const bool inputMatchesOutput = (inputLayout == layouts.getMainOutputChannelSet());
+    const bool hasChannelPairs = ! MidSideMatrix::findChannelPairs (inputLayout).empty();
     
-    return inputIsStereo && outputIsStereo;
+    return inputMatchesOutput && hasChannelPairs;
 }
 
 
@@ -141,18 +149,9 @@ bool MidsideAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
 
 void MidsideAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
 {
-    // let's find the address to our left and rigth channel data
-    // These pointers now point to the first sample for each array of numbers that represent the audio
-    float* leftChannel = buffer.getWritePointer(0);
-    float* rightChannel = buffer.getWritePointer(1);
-    
-    // number of samples in the block
-    const int numSamples = buffer.getNumSamples();
-    
-    // Get the width parameter value and store it to a value "sideGain"
-    const float sideGain = widthParameter->get();
-    // Also precalculate a variable for gaining the mid
-    const float midGain = 1.0f - sideGain;
+    // Get the width parameter values, and tell the width matrix that's where we want to go.
+    // The parameters are read only once per block, the matrix smooths the values in between.
+    widthMatrix.setWidths (widthParameter->get(), surroundWidthParameter->get());
 
     // Audio processing is typically done with "for loop"s.
     //
@@ -168,32 +167,10 @@ void MidsideAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer
     // 3. Increment variable values, i.e. advance the loop
     //      i += 1;
     //
-    // So lets iterate through all audio sample points in the buffer
-
-    for (int i = 0; i < numSamples; i++)
-    {
-        // Array access syntax [] can be used for pointers.
-        // Since both leftChannel and rightChannel point to the first sample of their respective arrays, we can access
-        // the successive sample with an integer (= int) value.
-        const float leftSample = leftChannel[i]; // get the i'th value of left channel, etc.
-        const float rightSample = rightChannel[i];
-        
-        // Calculate the mid and side at index i from the left and right sample at index i
-        float midSample = leftSample + rightSample;
-        float sideSample = leftSample - rightSample;
-        
-        // Manipulate mid and side samples with the width
-        midSample *= midGain;
-        sideSample *= sideGain;
-        
-        // Convert back to LR representation
-        float outputLeftSample = midSample + sideSample;
-        float outputRightSample = midSample - sideSample;
-        
-        // Replace the values of leftChannel and rightChannel at index i
-        leftChannel[i] = outputLeftSample;
-        rightChannel[i] = outputRightSample;
-    }
+    // The matrix loops through the left/right channel pairs of the buffer, and the loops that iterate through all audio
+    // sample points of a pair live in MidSideKernel.h. There's a plain scalar version of them, and a vectorised version
+    // that processes several samples at once.
+    widthMatrix.process (buffer);
 }
 
 bool MidsideAudioProcessor::hasEditor() const
@@ -1,6 +1,7 @@
 #pragma once // this line tells the compiler that this file is to be included only once, and that we can disregard this file's include if done more than once
 
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "MidSideMatrix.h"
 
 
 // 1.
@@ -86,6 +87,12 @@ public: // any other code can interact with public mehtods and member variables
     //
     // There's a more elaborate example on pointers at the bottom of PluginProcessor.h to get you started.
     AudioParameterFloat* widthParameter;
+    AudioParameterFloat* surroundWidthParameter;
+
+    // The width matrix does the actual processing for all left/right channel pairs of the layout.
+    // The width parameters can be automated, and jumping from one value to another between blocks creates audible steps,
+    // so the matrix smooths the width changes.
+    MidSideMatrix widthMatrix;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidsideAudioProcessor)
 };
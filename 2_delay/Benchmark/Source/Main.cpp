@@ -0,0 +1,158 @@
+// A small command line program that measures the interpolators of the delay line: how long each one takes per sample,
+// and how much it distorts a sine wave that goes through a modulated delay.
+//
+// The delay line includes "../JuceLibraryCode/JuceHeader.h" relative to its own folder, which only exists once the plug-in
+// has been saved in the Projucer. The exporters of this project add Benchmark/Source to the header search paths, so that
+// otherwise the same include finds the JuceLibraryCode of this project.
+//
+// Build the Release configuration, the numbers of a Debug build say nothing about the real cost.
+// The program returns 1 if the quality of the interpolators isn't in the expected order, so it can be run by a script.
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../Source/DelayLine.h"
+
+#include <chrono>
+#include <cstdio>
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+namespace
+{
+    const double sampleRate = 48000.0;
+    const int blockSize = 512;
+    const int numBlocks = 2000;             // about 21 seconds of audio per measurement
+    const int numTimingRuns = 5;            // the fastest run is reported, the others are disturbed by something else
+
+    // A 1 kHz sine through a delay of 100 samples that moves 20 samples up and down, once per second.
+    // That's a chorus-like modulation, the kind that the interpolators are there for.
+    const double sineFrequency = 1000.0;
+    const double delayCentre = 100.0;
+    const double delayDepth = 20.0;
+    const double modulationFrequency = 1.0;
+
+    struct Result
+    {
+        double nanosecondsPerSample = 0;
+        double cyclesPerSample = 0;
+        double thdPlusNoiseDb = 0;
+    };
+
+    // The time stamp counter counts the reference cycles of the CPU. It doesn't follow turbo boost, but it's the
+    // closest thing to a cycle count that we get without special permissions.
+    uint64_t readCycleCounter()
+    {
+       #if JUCE_INTEL
+        return (uint64_t) __rdtsc();
+       #else
+        return 0;
+       #endif
+    }
+
+    double getDelayTime(int64_t sampleIndex)
+    {
+        const double phase = MathConstants<double>::twoPi * modulationFrequency * (double) sampleIndex / sampleRate;
+        return delayCentre + delayDepth * std::sin(phase);
+    }
+
+    Result measure(Interpolation interpolation)
+    {
+        Result result;
+        result.nanosecondsPerSample = 1e9;
+        result.cyclesPerSample = 1e9;
+
+        std::vector<float> input((size_t) blockSize), output((size_t) blockSize), delayTimes((size_t) blockSize);
+
+        for (int run = 0; run < numTimingRuns; run++)
+        {
+            DelayLine<float> delayLine(4096, blockSize);
+            float tapState = 0;
+
+            double errorPower = 0, signalPower = 0;
+            std::chrono::nanoseconds elapsed(0);
+            uint64_t cycles = 0;
+
+            for (int block = 0; block < numBlocks; block++)
+            {
+                const int64_t blockStart = (int64_t) block * blockSize;
+
+                // The input and the delay times are calculated outside of the timed part
+                for (int i = 0; i < blockSize; i++)
+                {
+                    const int64_t n = blockStart + i;
+                    input[(size_t) i] = (float) std::sin(MathConstants<double>::twoPi * sineFrequency * (double) n / sampleRate);
+                    delayTimes[(size_t) i] = (float) getDelayTime(n);
+                }
+
+                delayLine.pushBlock(input.data(), blockSize);
+
+                const auto startTime = std::chrono::high_resolution_clock::now();
+                const uint64_t startCycles = readCycleCounter();
+
+                delayLine.readBlockInterpMultiTap(delayTimes.data(), 0, 1, output.data(), blockSize, interpolation, &tapState);
+
+                cycles += readCycleCounter() - startCycles;
+                elapsed += std::chrono::high_resolution_clock::now() - startTime;
+
+                // The first blocks read from the silence before the sine started, skip them
+                if (run > 0 || block < 4)
+                    continue;
+
+                // Compare to the sine that an ideal delay would give, read at exactly the delayed time.
+                // The delay time is rounded to float like the one that the delay line gets.
+                for (int i = 0; i < blockSize; i++)
+                {
+                    const int64_t n = blockStart + i;
+                    const double delayedTime = (double) n - (double) delayTimes[(size_t) i];
+                    const double ideal = std::sin(MathConstants<double>::twoPi * sineFrequency * delayedTime / sampleRate);
+                    const double error = (double) output[(size_t) i] - ideal;
+
+                    errorPower += error * error;
+                    signalPower += ideal * ideal;
+                }
+            }
+
+            const double numSamples = (double) numBlocks * blockSize;
+            result.nanosecondsPerSample = jmin(result.nanosecondsPerSample, (double) elapsed.count() / numSamples);
+            result.cyclesPerSample = jmin(result.cyclesPerSample, (double) cycles / numSamples);
+
+            if (run == 0)
+                result.thdPlusNoiseDb = 10.0 * std::log10(errorPower / signalPower);
+        }
+
+        return result;
+    }
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+    const char* names[] = { "none", "linear", "hermite", "lagrange", "allpass" };
+    const Interpolation interpolations[] = { Interpolation::none, Interpolation::linear, Interpolation::hermite,
+                                             Interpolation::lagrange, Interpolation::allpass };
+    Result results[5];
+
+    std::printf("%-10s %14s %14s %14s\n", "", "ns/sample", "cycles/sample", "THD+N (dB)");
+
+    for (int i = 0; i < 5; i++)
+    {
+        results[i] = measure(interpolations[i]);
+        std::printf("%-10s %14.3f %14.2f %14.1f\n", names[i], results[i].nanosecondsPerSample,
+                    results[i].cyclesPerSample, results[i].thdPlusNoiseDb);
+    }
+
+    // The cost depends too much on the machine to check it, but the quality doesn't:
+    // no interpolation has to be the worst by far, and the 4-point interpolators have to beat the linear one.
+    const double noneDb = results[0].thdPlusNoiseDb, linearDb = results[1].thdPlusNoiseDb;
+    const bool ok = noneDb > linearDb + 10
+                 && results[2].thdPlusNoiseDb < linearDb - 10
+                 && results[3].thdPlusNoiseDb < linearDb - 10
+                 && results[4].thdPlusNoiseDb < noneDb - 10;
+
+    std::printf(ok ? "OK\n" : "FAILED: the interpolators are not in the expected order of quality\n");
+    return ok ? 0 : 1;
+}
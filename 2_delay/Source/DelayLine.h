@@ -2,35 +2,245 @@
 // ^ always put that in the .h file
 
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "Interpolators.h"
 
 // A simple delay line with interpolated reads.
+//
+// The delay line can be used one sample at a time with pushSample and getDelayedSampleInterp,
+// or a block at a time with pushBlock and readBlockInterp. The block versions are a lot faster,
+// since they deal with the wrapping of the ring buffer in bigger pieces instead of for every single sample.
+//
+// The delay line is a template, so that it can store the same sample type that the processor uses, typically float.
+// This way there's no need to convert the samples when writing or reading them. As with all templates,
+// the implementation is in the header file.
+//
+// A few tricks are used to make the reads cheap:
+//
+// The length of the buffer is a power of two, e.g. 8192. With such a length, wrapping an index to the buffer is just
+// a bitwise AND with length - 1, i.e. the mask. That is a single instruction, and there's no branching needed.
+//
+// The interpolation reads four consecutive samples. The buffer has a few extra samples after its end, the guard,
+// that hold a copy of the first samples of the buffer. This way the four samples can always be read from one
+// piece of memory, even if they are on both sides of the wrapping point.
+//
+// The interpolated reads use the Lagrange interpolation by default. The block reads of several taps can use any of
+// the interpolators in Interpolators.h.
+template <typename SampleType>
 class DelayLine
 {
 public:
     
     // Constructor
-    // Has to allocate the buffer that we'll be using to store the samples
-    DelayLine(int maxNumSamples);
-    
-    // destructor
-    ~DelayLine();
+    // Has to allocate the buffer that we'll be using to store the samples.
+    // The buffer has to hold the longest delay, and a whole block of new samples on top of that.
+    DelayLine(int maxDelayInSamples, int maxBlockSize)
+    {
+        bufferLength = nextPowerOfTwo(maxDelayInSamples + maxBlockSize + numGuardSamples + 1);
+        mask = bufferLength - 1;
+        writehead = 0;
+        
+        // The vector allocates the memory and initialises all samples to 0.
+        // It also frees the memory when the delay line is deleted, so no destructor is needed.
+        buffer.resize(bufferLength + numGuardSamples, 0);
+        
+        // The read positions of one tap for a whole block
+        readIndices.resize(maxBlockSize);
+        readFractions.resize(maxBlockSize);
+    }
     
     // Push a new sample into the delay line
-    void pushSample(double sample);
+    void pushSample(SampleType sample)
+    {
+        buffer[writehead] = sample;
+        
+        // The first samples of the buffer are copied to the guard samples after the end of the buffer
+        if (writehead < numGuardSamples)
+            buffer[bufferLength + writehead] = sample;
+        
+        // Advance and wrap the writehead
+        writehead = (writehead + 1) & mask;
+    }
     
-    // Get a sample that has been delayed delayInSamples amount
-    double getDelayedSample(int delayInSamples);
+    // Get a sample that has been delayed delayInSamples amount.
+    // This is the non-interpolating delay read function for reference, in this example plug-in we're not using this one.
+    SampleType getDelayedSample(int delayInSamples)
+    {
+        // A delay of 0 is the sample that was pushed last
+        delayInSamples = jlimit(0, mask, delayInSamples);
+        return buffer[(writehead - 1 - delayInSamples) & mask];
+    }
     
     // Get a sample, but interpolated. We need to use this if the delay read tap moves
-    double getDelayedSampleInterp(float delayInSamples);
-
+    // A delay of 0 would be the sample that was pushed last, but the interpolation needs at least 1 sample of delay.
+    SampleType getDelayedSampleInterp(SampleType delayInSamples)
+    {
+        delayInSamples = jlimit((SampleType) 1, (SampleType) (bufferLength - numGuardSamples), delayInSamples);
+        
+        SampleType unusedState = 0;
+        return readInterp<LagrangeInterpolation<SampleType>>(writehead - 1, delayInSamples, unusedState);
+    }
+    
+    // Push a block of samples into the delay line
+    void pushBlock(const SampleType* samples, int numSamples)
+    {
+        jassert(numSamples <= bufferLength);
+        
+        // The block is written in at most two contiguous pieces: from the writehead to the end of the buffer,
+        // and the rest of it from the beginning of the buffer.
+        while (numSamples > 0)
+        {
+            const int numToWrite = jmin(numSamples, bufferLength - writehead);
+            
+            // A plain loop without any branches or wrapping, the compiler can vectorise this
+            for (int i = 0; i < numToWrite; i++)
+                buffer[writehead + i] = samples[i];
+            
+            // Copy the samples that were written to the beginning of the buffer to the guard samples
+            for (int i = writehead; i < jmin(writehead + numToWrite, numGuardSamples); i++)
+                buffer[bufferLength + i] = buffer[i];
+            
+            writehead = (writehead + numToWrite) & mask;
+            samples += numToWrite;
+            numSamples -= numToWrite;
+        }
+    }
+    
+    // Read a block of interpolated samples, one for each sample of the block that was pushed last.
+    // delayTimes has the delay in samples for each output sample, relative to the input sample at the same index.
+    // The delay line has to be longer than the delay time and the block length combined.
+    void readBlockInterp(const SampleType* delayTimes, SampleType* output, int numSamples)
+    {
+        SampleType unusedState = 0;
+        readBlock<LagrangeInterpolation<SampleType>>(writehead - numSamples, delayTimes, 0, 1, output, numSamples, &unusedState);
+    }
+    
+    // Read several taps for each sample of the block that was pushed last, and sum them together.
+    // tapDelayTimes has the delay times of the taps one after another, delayTimesStride samples apart.
+    // tapStates has a state variable for each tap, the interpolators that need to remember something use it.
+    // The taps are read one after another, each over the whole block, see readBlock.
+    void readBlockInterpMultiTap(const SampleType* tapDelayTimes, int delayTimesStride, int numTaps,
+                                 SampleType* output, int numSamples, Interpolation interpolation, SampleType* tapStates)
+    {
+        readBlockWithInterpolation(writehead - numSamples, tapDelayTimes, delayTimesStride, numTaps, output, numSamples, interpolation, tapStates);
+    }
+    
+    // Same as readBlockInterpMultiTap, but for the block that will be pushed next.
+    // This is what makes block processing possible with feedback: if all delay times are longer than the block by at least
+    // the lookahead of the interpolation, none of the samples we read are in the block that hasn't been pushed yet.
+    // So we can read the whole block first, and then calculate and push the whole block of input samples.
+    void readNextBlockInterpMultiTap(const SampleType* tapDelayTimes, int delayTimesStride, int numTaps,
+                                     SampleType* output, int numSamples, Interpolation interpolation, SampleType* tapStates)
+    {
+        readBlockWithInterpolation(writehead, tapDelayTimes, delayTimesStride, numTaps, output, numSamples, interpolation, tapStates);
+    }
+    
+    // The interpolation reads one sample newer than the integer part of the delay, so the shortest delay time that only reads
+    // samples that have already been pushed is numSamples + lookahead
+    static constexpr int interpolationLookahead = 1;
     
 private:
     
-    AudioBuffer<double>* buffer;
+    // Choose the interpolator once for the whole block
+    void readBlockWithInterpolation(int blockStartIndex, const SampleType* tapDelayTimes, int delayTimesStride, int numTaps,
+                                    SampleType* output, int numSamples, Interpolation interpolation, SampleType* tapStates)
+    {
+        switch (interpolation)
+        {
+            case Interpolation::none:
+                readBlock<NoInterpolation<SampleType>>(blockStartIndex, tapDelayTimes, delayTimesStride, numTaps, output, numSamples, tapStates);
+                break;
+            case Interpolation::linear:
+                readBlock<LinearInterpolation<SampleType>>(blockStartIndex, tapDelayTimes, delayTimesStride, numTaps, output, numSamples, tapStates);
+                break;
+            case Interpolation::hermite:
+                readBlock<HermiteInterpolation<SampleType>>(blockStartIndex, tapDelayTimes, delayTimesStride, numTaps, output, numSamples, tapStates);
+                break;
+            case Interpolation::lagrange:
+                readBlock<LagrangeInterpolation<SampleType>>(blockStartIndex, tapDelayTimes, delayTimesStride, numTaps, output, numSamples, tapStates);
+                break;
+            case Interpolation::allpass:
+                readBlock<AllpassInterpolation<SampleType>>(blockStartIndex, tapDelayTimes, delayTimesStride, numTaps, output, numSamples, tapStates);
+                break;
+        }
+    }
+    
+private:
+    
+    // The read loop, generated separately for each interpolator.
+    // blockStartIndex is the index of the input sample that the first output sample is delayed from.
+    //
+    // The taps are in the outer loop, so that the inner loops go through one contiguous row of delay times.
+    // For each tap, the read positions of the whole block are calculated first. That loop has no memory reads
+    // that depend on the data, so the compiler vectorises it. Then the second loop only fetches the samples
+    // and interpolates, with the state of the tap kept in a register for the whole block.
+    template <typename Interpolator>
+    void readBlock(int blockStartIndex, const SampleType* tapDelayTimes, int delayTimesStride, int numTaps,
+                   SampleType* output, int numSamples, SampleType* tapStates)
+    {
+        jassert(numSamples <= (int) readIndices.size());
+        
+        // The longest delay that we can read without the block overwriting the samples that we need
+        const SampleType maxDelay = (SampleType) (bufferLength - numSamples - numGuardSamples);
+        jassert(maxDelay >= 1);
+        
+        std::fill(output, output + numSamples, (SampleType) 0);
+        
+        int* indices = readIndices.data();
+        SampleType* fractions = readFractions.data();
+        
+        for (int tap = 0; tap < numTaps; tap++)
+        {
+            const SampleType* delayTimes = tapDelayTimes + tap * delayTimesStride;
+            
+            // The same calculation as in readInterp, for the whole row
+            for (int i = 0; i < numSamples; i++)
+            {
+                const SampleType delayInSamples = jlimit((SampleType) 1, maxDelay, delayTimes[i]);
+                const int delayInSamplesInt = (int) delayInSamples;
+                
+                fractions[i] = 1 - (delayInSamples - delayInSamplesInt);
+                indices[i] = (blockStartIndex + i - delayInSamplesInt - 2) & mask;
+            }
+            
+            SampleType state = tapStates[tap];
+            
+            for (int i = 0; i < numSamples; i++)
+                output[i] += Interpolator::interpolate(buffer.data() + indices[i], fractions[i], state);
+            
+            tapStates[tap] = state;
+        }
+    }
+    
+    // Read an interpolated sample delayInSamples behind the sample at newestIndex.
+    // The index doesn't have to be wrapped, the mask takes care of that.
+    template <typename Interpolator>
+    SampleType readInterp(int newestIndex, SampleType delayInSamples, SampleType& state) const
+    {
+        const int delayInSamplesInt = (int)delayInSamples;
+        
+        // The sample we want to read is between the samples at delayInSamplesInt + 1 and delayInSamplesInt.
+        // The interpolation position goes from the older sample towards the newer one, i.e. 1 - fractional part of the delay.
+        const SampleType fract = 1 - (delayInSamples - delayInSamplesInt);
+        
+        // The four samples that we need start one sample before the older sample.
+        // This index is wrapped only once, the guard samples take care of the rest.
+        const SampleType* taps = buffer.data() + ((newestIndex - delayInSamplesInt - 2) & mask);
+        
+        return Interpolator::interpolate(taps, fract, state);
+    }
+    
+    // Number of copied samples after the end of the buffer
+    static constexpr int numGuardSamples = 3;
+    
+    std::vector<SampleType> buffer;
+    
+    // Temporary buffers for readBlock, allocated in the constructor
+    std::vector<int> readIndices;
+    std::vector<SampleType> readFractions;
     
     int writehead;
-    const int maxNumSamples;
+    int bufferLength; // always a power of two
+    int mask;         // bufferLength - 1
 };
 
 
@@ -0,0 +1,265 @@
+#include "MultiTapDelay.h"
+
+MultiTapDelay::MultiTapDelay(int numChannelsToUse, int maxNumTapsToUse, double sr, int maxDelayInSamples, int maxBlockSizeToUse)
+: numChannels(numChannelsToUse)
+, maxNumTaps(maxNumTapsToUse)
+, maxBlockSize(jmax(1, maxBlockSizeToUse))
+, sampleRate(sr)
+{
+    for (int ch = 0; ch < numChannels; ch++)
+        delayLines.push_back(std::unique_ptr<DelayLine<float>>(new DelayLine<float>(maxDelayInSamples, maxBlockSize)));
+    
+    // Create the LFOs. The first tap of each channel is a quarter cycle ahead of the previous channel, so that
+    // with one tap, the left channel starts at 0 and the right channel at a quarter cycle.
+    // The phases of the other taps are set in setNumTaps, when they're taken into use.
+    for (int ch = 0; ch < numChannels; ch++)
+        for (int tap = 0; tap < maxNumTaps; tap++)
+            lfos.push_back(SineOscillator(sampleRate, 0, MathConstants<double>::halfPi * ch));
+    
+    // The rotations that spread the taps over the cycle, for every number of taps
+    for (int n = 1; n <= maxNumTaps; n++)
+    {
+        for (int tap = 0; tap < n; tap++)
+        {
+            const double angle = MathConstants<double>::twoPi * tap / n;
+            tapRotationCos.push_back(std::cos(angle));
+            tapRotationSin.push_back(std::sin(angle));
+        }
+    }
+    
+    tapDelayTimes.resize(maxNumTaps * maxBlockSize);
+    baseDelays.resize(maxBlockSize);
+    wetSamples.resize(maxBlockSize);
+    
+    // These will be used for feedback, initialise to zero
+    prevDelayedSamples.resize(numChannels, 0);
+    delayInputSamples.resize(maxBlockSize);
+    dampingStates.resize(numChannels, 0);
+    tapStates.resize(numChannels * maxNumTaps, 0);
+    
+    baseDelay.reset(sampleRate, glideTimeInSeconds);
+    isBaseDelaySet = false;
+    
+    numTaps = 0;
+    setNumTaps(1);
+}
+
+void MultiTapDelay::setNumTaps(int newNumTaps)
+{
+    newNumTaps = jlimit(1, maxNumTaps, newNumTaps);
+    
+    // Start the new taps from a copy of the first tap of the channel, rotated to their place in the cycle.
+    // With e.g. 1 -> 4 taps, the taps end up a quarter cycle apart. The existing taps aren't touched, so fewer taps
+    // just stops reading the ones at the end.
+    for (int ch = 0; ch < numChannels; ch++)
+    {
+        const SineOscillator& firstLfo = lfos[ch * maxNumTaps];
+        
+        for (int tap = numTaps; tap < newNumTaps; tap++)
+        {
+            SineOscillator& lfo = lfos[ch * maxNumTaps + tap];
+            lfo = firstLfo;
+            lfo.rotatePhase(tapRotationCos[getRotationIndex(newNumTaps, tap)], tapRotationSin[getRotationIndex(newNumTaps, tap)]);
+            
+            // The allpass interpolator of a new tap starts from silence
+            tapStates[ch * maxNumTaps + tap] = 0;
+        }
+    }
+    
+    numTaps = newNumTaps;
+}
+
+void MultiTapDelay::process(AudioBuffer<float>& buffer, const Settings& settings)
+{
+    // Changing the number of taps moves the LFO phases, so only do it when the number actually changes
+    if (settings.numTaps != numTaps)
+        setNumTaps(settings.numTaps);
+    
+    // Update the frequency of the LFOs
+    for (int ch = 0; ch < numChannels; ch++)
+        for (int tap = 0; tap < numTaps; tap++)
+            lfos[ch * maxNumTaps + tap].setFrequency(settings.lfoFrequency);
+    
+    // The first block starts right at the base delay, later changes glide to the new value
+    if (isBaseDelaySet)
+    {
+        baseDelay.setTargetValue(settings.baseDelayInSamples);
+    }
+    else
+    {
+        baseDelay.setCurrentAndTargetValue(settings.baseDelayInSamples);
+        isBaseDelaySet = true;
+    }
+    
+    const int numChannelsToProcess = jmin(numChannels, buffer.getNumChannels());
+    const int numSamples = buffer.getNumSamples();
+    
+    // Process the buffer in pieces that fit our temporary buffers
+    for (int pieceStart = 0; pieceStart < numSamples; pieceStart += maxBlockSize)
+    {
+        const int pieceLength = jmin(maxBlockSize, numSamples - pieceStart);
+        
+        // All channels glide together, so the base delays are calculated once for all of them
+        fillBaseDelays(pieceLength);
+        
+        for (int ch = 0; ch < numChannelsToProcess; ch++)
+            processChannel(ch, buffer.getWritePointer(ch) + pieceStart, pieceLength, settings);
+    }
+}
+
+void MultiTapDelay::fillBaseDelays(int numSamples)
+{
+    if (baseDelay.isSmoothing())
+    {
+        // A ramp, one step per sample
+        for (int i = 0; i < numSamples; i++)
+            baseDelays[i] = baseDelay.getNextValue();
+    }
+    else
+    {
+        // Most of the time the delay isn't gliding, and the whole piece has the same value
+        FloatVectorOperations::fill(baseDelays.data(), baseDelay.getTargetValue(), numSamples);
+    }
+}
+
+void MultiTapDelay::processChannel(int channel, float* data, int numSamples, const Settings& settings)
+{
+    DelayLine<float>& delayLine = *delayLines[channel];
+    float& prevDelayedSample = prevDelayedSamples[channel];
+    float* channelTapStates = tapStates.data() + channel * maxNumTaps;
+    const float wetDryRatio = settings.wetDryRatio;
+    
+    // Since we have LFOs, the delay in samples changes for every sample.
+    // Generate the LFO of each tap to its own row of the delay time buffer.
+    for (int tap = 0; tap < numTaps; tap++)
+        lfos[channel * maxNumTaps + tap].fillBlock(tapDelayTimes.data() + tap * maxBlockSize, numSamples);
+    
+    // Then scale the LFO values to the modulation depth. The rows are one after another in memory,
+    // so this is a single vectorised pass over all taps. The unused end of the last row is processed too,
+    // but that's cheaper than doing a separate pass for every row.
+    const int numDelayTimes = (numTaps - 1) * maxBlockSize + numSamples;
+    FloatVectorOperations::multiply(tapDelayTimes.data(), settings.modulationInSamples, numDelayTimes);
+    
+    // And offset each row by the base delay times
+    for (int tap = 0; tap < numTaps; tap++)
+        FloatVectorOperations::add(tapDelayTimes.data() + tap * maxBlockSize, baseDelays.data(), numSamples);
+    
+    if (settings.feedbackGain == 0.0f)
+    {
+        // Without feedback, the input doesn't depend on the output, so we can push the whole block in
+        // and then read the whole block out. Both of these are simple loops without any wrapping in them.
+        delayLine.pushBlock(data, numSamples);
+        delayLine.readBlockInterpMultiTap(tapDelayTimes.data(), maxBlockSize, numTaps, wetSamples.data(), numSamples,
+                                          settings.interpolation, channelTapStates);
+        
+        // The taps are summed, so scale the sum back to the level of a single tap
+        FloatVectorOperations::multiply(wetSamples.data(), 1.0f / numTaps, numSamples);
+    }
+    else
+    {
+        processWithFeedback(channel, data, numSamples, settings);
+    }
+    
+    // Store what the last delayed sample was, in case feedback is turned on for the next block
+    prevDelayedSample = wetSamples[numSamples - 1];
+    
+    // Replace the output samples with a mixture of wet and dry samples
+    for (int i = 0; i < numSamples; i++)
+        data[i] = wetDryRatio * wetSamples[i] + (1 - wetDryRatio) * data[i];
+}
+
+void MultiTapDelay::processWithFeedback(int channel, const float* input, int numSamples, const Settings& settings)
+{
+    DelayLine<float>& delayLine = *delayLines[channel];
+    float& prevDelayedSample = prevDelayedSamples[channel];
+    float* channelTapStates = tapStates.data() + channel * maxNumTaps;
+    
+    // With feedback, each input sample needs the previous output sample. But an output sample only depends on input
+    // samples that are at least the shortest delay time old. So if the shortest delay is e.g. 44 samples, we can read
+    // 43 output samples in one go, then calculate the 43 input samples from them and push them in one go.
+    // The result is exactly the same as going one sample at a time.
+    float minDelay = std::numeric_limits<float>::max();
+    for (int tap = 0; tap < numTaps; tap++)
+        minDelay = jmin(minDelay, FloatVectorOperations::findMinimum(tapDelayTimes.data() + tap * maxBlockSize, numSamples));
+    
+    const int subBlockLength = (int) jmax(0.0f, minDelay) - DelayLine<float>::interpolationLookahead;
+    
+    if (subBlockLength < 1)
+    {
+        // The delay is too short for sub-blocks, so go one sample at a time.
+        // Push first and then read, this way a delay of 1 sample reads the sample that was just pushed.
+        for (int i = 0; i < numSamples; i++)
+        {
+            // Push the sample to the delay line, and add the previous sample for the feedback effect
+            float delayInput = prevDelayedSample;
+            processFeedbackSignal(channel, &delayInput, 1, settings);
+            delayInput += input[i];
+            delayLine.pushBlock(&delayInput, 1);
+            
+            // Read all taps for this one sample, the delay times of sample i start at index i of the rows
+            float sum;
+            delayLine.readBlockInterpMultiTap(tapDelayTimes.data() + i, maxBlockSize, numTaps, &sum, 1,
+                                              settings.interpolation, channelTapStates);
+            
+            // Get the new delayed sample, and store it to use it the next time around
+            wetSamples[i] = sum * (1.0f / numTaps);
+            prevDelayedSample = wetSamples[i];
+        }
+        
+        return;
+    }
+    
+    for (int start = 0; start < numSamples; start += subBlockLength)
+    {
+        const int length = jmin(subBlockLength, numSamples - start);
+        float* wet = wetSamples.data() + start;
+        
+        // Read the output of the sub-block before its input has been pushed
+        delayLine.readNextBlockInterpMultiTap(tapDelayTimes.data() + start, maxBlockSize, numTaps, wet, length,
+                                              settings.interpolation, channelTapStates);
+        FloatVectorOperations::multiply(wet, 1.0f / numTaps, length);
+        
+        // Each input sample gets the output sample before it as feedback,
+        // so the feedback signal is the output shifted by one sample
+        delayInputSamples[0] = prevDelayedSample;
+        FloatVectorOperations::copy(delayInputSamples.data() + 1, wet, length - 1);
+        prevDelayedSample = wet[length - 1];
+        
+        processFeedbackSignal(channel, delayInputSamples.data(), length, settings);
+        FloatVectorOperations::add(delayInputSamples.data(), input + start, length);
+        
+        delayLine.pushBlock(delayInputSamples.data(), length);
+    }
+}
+
+void MultiTapDelay::processFeedbackSignal(int channel, float* samples, int numSamples, const Settings& settings)
+{
+    float& dampingState = dampingStates[channel];
+    
+    if (settings.feedbackDamping > 0.0f)
+    {
+        // A one-pole lowpass filter: each sample moves the state a bit towards the input sample.
+        // The smaller the step, the more high frequencies are removed. The step doesn't go all the way to zero,
+        // so that the feedback doesn't disappear completely on full damping.
+        const float step = 1.0f - 0.95f * settings.feedbackDamping;
+        
+        for (int i = 0; i < numSamples; i++)
+        {
+            dampingState += step * (samples[i] - dampingState);
+            samples[i] = dampingState;
+        }
+    }
+    else
+    {
+        // Keep the filter up to date, so that turning the damping on doesn't cause a click
+        dampingState = samples[numSamples - 1];
+    }
+    
+    FloatVectorOperations::multiply(samples, settings.feedbackGain, numSamples);
+    
+    // Soft clipping keeps the feedback from growing without bounds, even with a feedback gain of 1.
+    // Each round through the loop gets a bit more saturated, like on a tape echo.
+    if (settings.feedbackSaturation)
+        for (int i = 0; i < numSamples; i++)
+            samples[i] = std::tanh(samples[i]);
+}
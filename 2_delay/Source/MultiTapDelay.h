@@ -0,0 +1,107 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DelayLine.h"
+#include "SineOscillator.h"
+
+// A modulated delay for any number of channels, with any number of taps per channel.
+//
+// Each channel has one delay line, and each tap reads from it with its own LFO. The LFOs of a channel are spread evenly
+// over the LFO cycle, so that the delay times of the taps go up and down at different times. That is what makes a chorus
+// or an ensemble effect sound wide. With one tap per channel, this is the same as a plain modulated delay.
+//
+// The data is laid out as a so-called struct of arrays: instead of having an object for each tap with its own small buffers,
+// the delay times of all taps of a channel are stored in one contiguous buffer, one row per tap. This way converting the LFO
+// values to delay times is a single vectorised pass over all taps, and the delay line reads all taps of a sample in one go.
+class MultiTapDelay
+{
+public:
+    
+    // The parameter values of the current block, converted to the units that the processing needs
+    struct Settings
+    {
+        int numTaps;
+        float baseDelayInSamples;   // changes glide from the previous value
+        float modulationInSamples;
+        float lfoFrequency;
+        float feedbackGain;
+        float wetDryRatio;
+        Interpolation interpolation;
+        
+        // Feedback path processing, 0 and false are off
+        float feedbackDamping;      // 0...1, the amount of high frequencies removed from the feedback
+        bool feedbackSaturation;    // soft clip the feedback, so that it can't grow out of bounds
+    };
+    
+    // Allocates all the memory that the delay needs, so create this in prepareToPlay
+    MultiTapDelay(int numChannels, int maxNumTaps, double sampleRate, int maxDelayInSamples, int maxBlockSize);
+    
+    // Process all channels of the buffer in place
+    void process(AudioBuffer<float>& buffer, const Settings& settings);
+    
+private:
+    
+    // Change the number of taps. The taps that exist already keep their LFO phases, so that nothing clicks,
+    // and the new taps start evenly spread from the phase of the first tap of their channel.
+    void setNumTaps(int newNumTaps);
+    
+    // Fill baseDelays for the next numSamples samples, ramping if the base delay is gliding
+    void fillBaseDelays(int numSamples);
+    
+    // Process a piece of a channel that fits the temporary buffers
+    void processChannel(int channel, float* data, int numSamples, const Settings& settings);
+    
+    // Process the delay with feedback, in sub-blocks as long as the shortest delay time allows
+    void processWithFeedback(int channel, const float* input, int numSamples, const Settings& settings);
+    
+    // Damping, gain and saturation of the delayed samples that are fed back to the input, in place
+    void processFeedbackSignal(int channel, float* samples, int numSamples, const Settings& settings);
+    
+    const int numChannels;
+    const int maxNumTaps;
+    const int maxBlockSize;
+    const double sampleRate;
+    
+    int numTaps;
+    
+    // One delay line per channel
+    std::vector<std::unique_ptr<DelayLine<float>>> delayLines;
+    
+    // One LFO per tap, the LFO of a tap is at index channel * maxNumTaps + tap
+    std::vector<SineOscillator> lfos;
+    
+    // The cosine and sine of the angle 2 * pi * tap / numTaps for every number of taps, so that setNumTaps doesn't
+    // need to call cos() and sin() on the audio thread. The rotation of a tap is at index getRotationIndex(numTaps, tap).
+    std::vector<double> tapRotationCos;
+    std::vector<double> tapRotationSin;
+    
+    static int getRotationIndex(int numTapsInUse, int tap) { return numTapsInUse * (numTapsInUse - 1) / 2 + tap; }
+    
+    // The delay times of the taps, the delay time of a sample is at index tap * maxBlockSize + sample
+    std::vector<float> tapDelayTimes;
+    
+    // The base delay time glides to a new value in this time, so that changing it doesn't click
+    static constexpr double glideTimeInSeconds = 0.1;
+    
+    // The current base delay time and where it's gliding to
+    SmoothedValue<float> baseDelay;
+    bool isBaseDelaySet;
+    
+    // The base delay time for each sample of the piece that is being processed, same for all channels
+    std::vector<float> baseDelays;
+    
+    // Sum of the taps
+    std::vector<float> wetSamples;
+    
+    // The previous output of each channel, used for the feedback
+    std::vector<float> prevDelayedSamples;
+    
+    // The feedback signal of a sub-block, and the samples that are pushed to the delay line
+    std::vector<float> delayInputSamples;
+    
+    // The state of the damping filter of each channel
+    std::vector<float> dampingStates;
+    
+    // The interpolator state of each tap, at index channel * maxNumTaps + tap. Only the allpass interpolator uses these.
+    std::vector<float> tapStates;
+};
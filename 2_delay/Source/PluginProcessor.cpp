@@ -1,6 +1,11 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+// The note divisions that the delay can be synced to, and their lengths in quarter notes.
+// T is a triplet, which is 2/3 of the straight note, and . is a dotted note, which is 3/2 of the straight note.
+static const char* const noteDivisionNames[] = { "1/64", "1/32T", "1/32", "1/16T", "1/16", "1/8T", "1/8", "1/8.", "1/4" };
+static const double noteDivisionLengthsInBeats[] = { 1.0/16, 1.0/12, 1.0/8, 1.0/6, 1.0/4, 1.0/3, 1.0/2, 3.0/4, 1.0 };
+
 //==============================================================================
 DelayExampleAudioProcessor::DelayExampleAudioProcessor()
      : AudioProcessor (BusesProperties()
@@ -41,12 +46,52 @@ DelayExampleAudioProcessor::DelayExampleAudioProcessor()
                                               1,            // maximum value
                                               0.5);
     
+    // More taps make the effect thicker, e.g. a chorus or an ensemble
+    numTapsParam = new AudioParameterInt("numTaps",    // internal name, host is using this to know which parameter it is
+                                         "Taps",       // this is the name that the user sees
+                                         1,            // minimum value
+                                         maxNumTaps,   // maximum value
+                                         1);           // default
+    
+    // The choices are in the same order as the Interpolation enum, so the index of the choice can be cast to it.
+    // Lagrange is the default, that's what the delay has always used.
+    interpolationParam = new AudioParameterChoice("interpolation",     // internal name, host is using this to know which parameter it is
+                                                  "Interpolation",     // this is the name that the user sees
+                                                  StringArray("None", "Linear", "Hermite", "Lagrange", "Allpass"),
+                                                  3);                  // default, Lagrange
+    
+    // Damping removes high frequencies from the feedback, so that each echo is a bit darker than the previous one
+    dampingParam = new AudioParameterFloat("damping",   // internal name, host is using this to know which parameter it is
+                                           "Damping",   // this is the name that the user sees
+                                           0,           // minimum value, no damping
+                                           1,           // maximum value
+                                           0);          // default
+    
+    saturationParam = new AudioParameterBool("saturation",          // internal name, host is using this to know which parameter it is
+                                             "Feedback Saturation", // this is the name that the user sees
+                                             false);                // default
+    
+    // With tempo sync on, the delay length comes from the host's tempo and the note division instead of the delay length parameter
+    tempoSyncParam = new AudioParameterBool("tempoSync",  // internal name, host is using this to know which parameter it is
+                                            "Tempo Sync", // this is the name that the user sees
+                                            false);       // default
+    
+    noteDivisionParam = new AudioParameterChoice("noteDivision",  // internal name, host is using this to know which parameter it is
+                                                 "Note Division", // this is the name that the user sees
+                                                 StringArray(noteDivisionNames, numElementsInArray(noteDivisionNames)),
+                                                 4);              // default, 1/16
+    
     addParameter(delayLengthParam);
     addParameter(modAmountParam);
     addParameter(feedbackParam);
     addParameter(lfoSpeedParam);
     addParameter(wetDryMixParam);
-    
+    addParameter(numTapsParam);
+    addParameter(interpolationParam);
+    addParameter(dampingParam);
+    addParameter(saturationParam);
+    addParameter(tempoSyncParam);
+    addParameter(noteDivisionParam);
 }
 
 DelayExampleAudioProcessor::~DelayExampleAudioProcessor()
@@ -106,24 +151,20 @@ void DelayExampleAudioProcessor::changeProgramName (int index, const String& new
 // We should create our delay lines and LFOs here, since this is the first occasion we'll know what the samplerate will be
 void DelayExampleAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    const int maxDelayLineInSamples = 10 * sampleRate;
+    // The longest delay we'll ever read is the maximum delay length plus the maximum modulation.
+    // Let's ask those from the parameters' ranges, so that the delay line grows automatically if we ever change the ranges.
+    // With tempo sync, the delay length can go up to the synced maximum instead.
+    const double maxDelayLengthInSeconds = jmax((double) delayLengthParam->range.end, maxSyncedDelayInSeconds);
+    const double maxDelayInSeconds = maxDelayLengthInSeconds + modAmountParam->range.end / 1000;
+    const int maxDelayInSamples = (int) std::ceil(maxDelayInSeconds * sampleRate) + 1;
     
     // To assign a new object to std::unique_ptr, we call its reset().
     // This deletes the old object, if one exists, and moves to point to the new object.
-    leftDelayLine.reset(new DelayLine(maxDelayLineInSamples));
-    rightDelayLine.reset(new DelayLine(maxDelayLineInSamples));
-
-    // Create our LFOs
-    const double frequencyInHz = lfoSpeedParam->get();
-    const double leftStartingPhase = MathConstants<double>::twoPi * 0;
-    const double rightStartingPhase = MathConstants<double>::twoPi * 0.25;
-    
-    leftLfoOsc.reset(new SineOscillator(sampleRate, frequencyInHz, leftStartingPhase));
-    rightLfoOsc.reset(new SineOscillator(sampleRate, frequencyInHz, rightStartingPhase));
-    
-    // These will be used for feedback, initialise to zero
-    prevLeftDelayedSample = 0;
-    prevRightDelayedSample = 0;
+    //
+    // The delay allocates its delay lines, LFOs and temporary buffers in its constructor, since allocating memory in
+    // processBlock is a no-no. If the host gives us bigger blocks than promised, the delay processes them in pieces.
+    const int numChannels = getTotalNumOutputChannels();
+    delay.reset(new MultiTapDelay(numChannels, maxNumTaps, sampleRate, maxDelayInSamples, samplesPerBlock));
 }
 
 void DelayExampleAudioProcessor::releaseResources()
@@ -134,21 +175,20 @@ void DelayExampleAudioProcessor::releaseResources()
 
 bool DelayExampleAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
-    // support for stereo-in-stereo-out
-    if (layouts.getMainInputChannelSet() == AudioChannelSet::stereo()
-        && layouts.getMainOutputChannelSet() == AudioChannelSet::stereo())
+    const int numInputs = layouts.getMainInputChannelSet().size();
+    const int numOutputs = layouts.getMainOutputChannelSet().size();
+    
+    // support for any number of channels, as long as input and output have the same number of them
+    if (numInputs > 0 && numInputs == numOutputs)
     {
         return true;
     }
     
-    // support for mono-in-mono-out and mono-in-stereo-out
-    if (layouts.getMainInputChannelSet() == AudioChannelSet::mono())
+    // support for mono-in-stereo-out
+    if (layouts.getMainInputChannelSet() == AudioChannelSet::mono()
+        && layouts.getMainOutputChannelSet() == AudioChannelSet::stereo())
     {
-        if (layouts.getMainOutputChannelSet() == AudioChannelSet::mono()
-            || layouts.getMainOutputChannelSet() == AudioChannelSet::stereo())
-        {
-            return true;
-        }
+        return true;
     }
     return false;
 }
@@ -164,95 +204,48 @@ void DelayExampleAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiB
     const int numOutputs = getTotalNumOutputChannels();
 
     const float maxAmplitudeInSeconds = modAmountParam->get() / 1000;
-    const float baseDelayInSeconds = delayLengthParam->get();
-    const float wetDryRatio = wetDryMixParam->get();
+    const double baseDelayInSeconds = getDelayTimeInSeconds();
     const double samplerate = getSampleRate();
     
-    const float feedbackGain = feedbackParam->get();
+    // Collect the parameter values for this block, so that all channels use exactly the same values
+    MultiTapDelay::Settings settings;
+    settings.numTaps = numTapsParam->get();
+    settings.baseDelayInSamples = baseDelayInSeconds * samplerate;
+    settings.modulationInSamples = maxAmplitudeInSeconds * samplerate;
+    settings.lfoFrequency = lfoSpeedParam->get();
+    settings.feedbackGain = feedbackParam->get();
+    settings.wetDryRatio = wetDryMixParam->get();
+    settings.interpolation = static_cast<Interpolation>(interpolationParam->getIndex());
+    settings.feedbackDamping = dampingParam->get();
+    settings.feedbackSaturation = saturationParam->get();
     
-    const int numSamplesInInput = buffer.getNumSamples();
+    // For mono to stereo, use the left channel input for right channel as well
+    if (numInputs == 1 && numOutputs == 2)
+        buffer.copyFrom(1, 0, buffer, 0, 0, buffer.getNumSamples());
     
-    // Mono processing
-    if (numInputs == 1 && numOutputs == 1)
-    {
-        // Update the frequency of the LFO
-        const float lfoFreqInSecs = lfoSpeedParam->get();
-        leftLfoOsc->setFrequency(lfoFreqInSecs);
-        
-        // Get access to the audio channel
-        float* monoData = buffer.getWritePointer(0);
-
-        // Process each sample
-        for (int i = 0; i < numSamplesInInput; i++)
-        {
-            float inputSample = monoData[i];
-            
-            // Since we have an LFO, the delay in samples changes for every sample
-            float delayInSamples = baseDelayInSeconds * samplerate + leftLfoOsc->getNextSample() * maxAmplitudeInSeconds * samplerate;
+    // Every channel goes through its own delay line and LFOs, no matter how many channels there are
+    delay->process(buffer, settings);
+}
 
-            // Push the sample to the delay line, and add the previous sample for the feedback effect
-            leftDelayLine->pushSample(inputSample + prevLeftDelayedSample * feedbackGain);
-            
-            // Get the new delayed sample
-            float wetSample = leftDelayLine->getDelayedSampleInterp(delayInSamples);
-            float drySample = monoData[i];
-            
-            // Replace the output sample with a mixture of wet and dry samples
-            monoData[i] = wetDryRatio * wetSample + (1-wetDryRatio) * drySample;
-            
-            // Store what the previous sample was to use it the next time around
-            prevLeftDelayedSample = wetSample;
-        }
-    }
-    // Stereo processing
-    // This is essentially the mono version but doubled up for both channels
-    // We could generalise and refactor the processing to a separate function and call it for both channels as needed
-    // instead of copying the code like this.
-    else if (numOutputs == 2)
+double DelayExampleAudioProcessor::getDelayTimeInSeconds()
+{
+    if (! tempoSyncParam->get())
+        return delayLengthParam->get();
+    
+    // Ask the host for the tempo. Not all hosts have a playhead or a tempo, so keep using the last tempo we got.
+    if (AudioPlayHead* playHead = getPlayHead())
     {
-        // update the frequency of lfo
-        const float lfoFreqInSecs = lfoSpeedParam->get();
-        leftLfoOsc->setFrequency(lfoFreqInSecs);
-        rightLfoOsc->setFrequency(lfoFreqInSecs);
-        
-        float* leftData = buffer.getWritePointer(0);
-        float* rightData = buffer.getWritePointer(1);
+        AudioPlayHead::CurrentPositionInfo positionInfo;
         
-        for (int i = 0; i < numSamplesInInput; i++)
-        {
-            float leftSample = leftData[i];
-            float rightSample;
-            
-            // Handle stereo to stereo
-            if (numInputs == 2)
-            {
-                rightSample = rightData[i];
-            }
-            // For mono to stereo, use the left channel input for right channel as well
-            else
-            {
-                rightSample = leftSample;
-            }
-            
-            float leftDelayInSamples = baseDelayInSeconds * samplerate + leftLfoOsc->getNextSample() * maxAmplitudeInSeconds*samplerate;
-            float rightDelayInSamples = baseDelayInSeconds * samplerate + rightLfoOsc->getNextSample() * maxAmplitudeInSeconds*samplerate;
-
-            leftDelayLine->pushSample(leftSample + prevLeftDelayedSample * feedbackGain);
-            rightDelayLine->pushSample(rightSample + prevRightDelayedSample * feedbackGain);
-            
-            float leftWetSample = leftDelayLine->getDelayedSampleInterp (leftDelayInSamples);
-            float rightWetSample = rightDelayLine->getDelayedSampleInterp (rightDelayInSamples);
-            
-            float leftDrySample = leftData[i];
-            float rightDrySample = rightData[i];
-            
-            leftData[i] = wetDryRatio * leftWetSample + (1 - wetDryRatio) * leftDrySample;
-            rightData[i] = wetDryRatio * rightWetSample + (1 - wetDryRatio) * rightDrySample;
-            
-            prevLeftDelayedSample = leftWetSample;
-            prevRightDelayedSample = rightWetSample;
-        }
+        if (playHead->getCurrentPosition(positionInfo) && positionInfo.bpm > 0)
+            lastKnownBpm = positionInfo.bpm;
     }
+    
+    // One beat is a quarter note, and lasts 60 / BPM seconds
+    const double beatLengthInSeconds = 60.0 / lastKnownBpm;
+    const double delayInSeconds = noteDivisionLengthsInBeats[noteDivisionParam->getIndex()] * beatLengthInSeconds;
+    
+    return jmin(delayInSeconds, maxSyncedDelayInSeconds);
 }
 
 //==============================================================================
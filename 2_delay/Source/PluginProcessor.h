@@ -4,13 +4,15 @@
 // could be adapted to work as a modulating delay, flanger, chorus by changing
 // the delay and modulation times, and by adding more delay taps.
 //
-// The delay line reads have cubic interpolation
+// The delay works with any number of channels, and each channel can have several modulated taps.
+// The interpolation of the delay line reads is chosen with the interpolation parameter: none, linear, Hermite,
+// Lagrange (the default) or a Thiran allpass, see Interpolators.h
+// The delay time can follow the tempo of the host, and changes to it glide smoothly
 
 #pragma once
 
 #include "../JuceLibraryCode/JuceHeader.h"
-#include "DelayLine.h"
-#include "SineOscillator.h"
+#include "MultiTapDelay.h"
 class DelayExampleAudioProcessor : public AudioProcessor
 {
 public:
@@ -45,15 +47,24 @@ public:
     
 private:
     
+    // The most taps per channel that the delay can have
+    static constexpr int maxNumTaps = 16;
+    
+    // Tempo synced delays can be longer than the delay length parameter, e.g. a 1/4 note at 60 BPM is one second.
+    // The synced delay time is limited to this, so that the delay line doesn't have to grow when the tempo changes.
+    static constexpr double maxSyncedDelayInSeconds = 2.0;
+    
+    // Delay time in seconds, either from the delay length parameter or from the tempo and the note division
+    double getDelayTimeInSeconds();
+    
+    // The tempo of the last block that had one, used if the host doesn't tell the tempo
+    double lastKnownBpm = 120.0;
+    
     // std::unique_ptr is a smart pointer to an object
     // It will delete the object it points to when exiting, so no need to call:
-    //      delete leftDelayLine;
+    //      delete delay;
     // in the destructor.
-    std::unique_ptr<DelayLine> leftDelayLine;
-    std::unique_ptr<DelayLine> rightDelayLine;
-    
-    std::unique_ptr<SineOscillator> leftLfoOsc;
-    std::unique_ptr<SineOscillator> rightLfoOsc;
+    std::unique_ptr<MultiTapDelay> delay;
 
     // add pointers to parameters
     AudioParameterFloat* delayLengthParam;
@@ -61,10 +72,12 @@ private:
     AudioParameterFloat* feedbackParam;
     AudioParameterFloat* lfoSpeedParam;
     AudioParameterFloat* wetDryMixParam;
-    
-    // member variables
-    float prevLeftDelayedSample;
-    float prevRightDelayedSample;
+    AudioParameterInt* numTapsParam;
+    AudioParameterChoice* interpolationParam;
+    AudioParameterFloat* dampingParam;
+    AudioParameterBool* saturationParam;
+    AudioParameterBool* tempoSyncParam;
+    AudioParameterChoice* noteDivisionParam;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayExampleAudioProcessor)
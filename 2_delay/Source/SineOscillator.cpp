@@ -3,8 +3,18 @@
 SineOscillator::SineOscillator(double sr, double freq, double initialPhase)
 {
     samplerate = sr;
-    frequency = freq;
-    currentPhaseState = initialPhase;
+    
+    cosState = cos(initialPhase);
+    sinState = sin(initialPhase);
+    
+    // The first call to fillBlock starts the interpolation from the initial phase
+    currentValue = cosState;
+    valueIncrement = 0;
+    samplesUntilControlPoint = 0;
+    
+    // An impossible frequency, so that setFrequency calculates the rotation
+    frequency = -1;
+    setFrequency(freq);
 }
 
 double SineOscillator::getFrequency()
@@ -14,8 +24,8 @@ double SineOscillator::getFrequency()
 
 void SineOscillator::setFrequency(double newFrequency)
 {
-    // frequency can't be above nyquist or below 0
-    const double nyquist = samplerate/2;
+    // frequency can't be above the nyquist of the control rate or below 0
+    const double nyquist = samplerate / controlInterval / 2;
     
     // first, let's check that the new frequency is not below 0
     if (newFrequency < 0)
@@ -28,32 +38,80 @@ void SineOscillator::setFrequency(double newFrequency)
     if (newFrequency > nyquist)
     {
         // if above nyquist, cap it to nyquist
-        frequency = nyquist;
-    }
-    else
-    {
-        frequency = newFrequency;
+        newFrequency = nyquist;
     }
+    
+    // The frequency is set every block, so only calculate the rotation if it actually changed
+    if (newFrequency == frequency)
+        return;
+    
+    frequency = newFrequency;
+    
+    const double phaseIncrement = frequency / samplerate * MathConstants<double>::twoPi * controlInterval;
+    rotationCos = cos(phaseIncrement);
+    rotationSin = sin(phaseIncrement);
 }
 
 double SineOscillator::getNextSample()
 {
-    double phaseIncrement = frequency / samplerate * MathConstants<double>::twoPi;
-    
-    currentPhaseState += phaseIncrement;
-    
-    // wrap the phase
-    if (currentPhaseState > MathConstants<double>::twoPi)
-        currentPhaseState -= MathConstants<double>::twoPi;
-    
-    double oscillation = cos(currentPhaseState);
+    float oscillation;
+    fillBlock(&oscillation, 1);
     return oscillation;
 }
 
+void SineOscillator::fillBlock(float* dest, int numSamples)
+{
+    int i = 0;
+    
+    while (i < numSamples)
+    {
+        if (samplesUntilControlPoint == 0)
+            advanceToNextControlPoint();
+        
+        // Interpolate up to the next control point or the end of the block, whichever comes first
+        const int numToFill = jmin(samplesUntilControlPoint, numSamples - i);
+        
+        // The value is calculated from the index instead of adding the increment sample by sample,
+        // so that the compiler can vectorise the loop
+        for (int j = 0; j < numToFill; j++)
+            dest[i + j] = (float) (currentValue + j * valueIncrement);
+        
+        currentValue += numToFill * valueIncrement;
+        samplesUntilControlPoint -= numToFill;
+        i += numToFill;
+    }
+}
 
+void SineOscillator::rotatePhase(double angleCos, double angleSin)
+{
+    const double newCos = cosState * angleCos - sinState * angleSin;
+    const double newSin = sinState * angleCos + cosState * angleSin;
+    cosState = newCos;
+    sinState = newSin;
+    
+    // Start a new interpolation from the rotated point on the next fillBlock
+    currentValue = cosState;
+    valueIncrement = 0;
+    samplesUntilControlPoint = 0;
+}
 
-
-
-
-
-
+void SineOscillator::advanceToNextControlPoint()
+{
+    // Start the interpolation from where the quadrature state is now, so that the rounding errors of the
+    // interpolation don't accumulate from one control point to the next
+    const double startValue = cosState;
+    
+    // Rotate the point (cos, sin) on the unit circle by the phase increment
+    const double newCos = cosState * rotationCos - sinState * rotationSin;
+    const double newSin = sinState * rotationCos + cosState * rotationSin;
+    
+    // Due to rounding errors, the point slowly drifts away from the unit circle. This pulls it back,
+    // it's a cheap approximation of dividing by the length of the vector when the length is close to 1.
+    const double lengthCorrection = 1.5 - 0.5 * (newCos * newCos + newSin * newSin);
+    cosState = newCos * lengthCorrection;
+    sinState = newSin * lengthCorrection;
+    
+    currentValue = startValue;
+    valueIncrement = (cosState - startValue) / controlInterval;
+    samplesUntilControlPoint = controlInterval;
+}
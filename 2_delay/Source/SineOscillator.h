@@ -4,6 +4,20 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 
 // A simple sine oscillator that we use for our LFOs
+//
+// Calling cos() for every sample is expensive, and an LFO doesn't really need that kind of precision anyway.
+// So instead, the oscillator works at a control rate: it calculates an exact value every controlInterval samples,
+// and interpolates linearly between them.
+//
+// The exact values come from a so-called quadrature oscillator. It keeps track of the cosine and sine of the phase,
+// i.e. a point on the unit circle, and advances the phase by rotating the point with a precomputed rotation.
+// A rotation is just four multiplications, so no cos() is needed at all unless the frequency changes.
+//
+// Accuracy:
+// The quadrature state is in double precision and it's nudged back to the unit circle on every control point,
+// so it doesn't drift in amplitude or phase. The error comes from the linear interpolation, and for a cosine it is at most
+// (2 * pi * frequency / samplerate * controlInterval)^2 / 8. With controlInterval 32 at 44.1 kHz, that is 2.6e-6 for
+// a 1 Hz LFO and 2.6e-4 for a 10 Hz LFO, relative to the LFO amplitude.
 class SineOscillator
 {
 public:
@@ -17,15 +31,38 @@ public:
     // Set a new frequency
     void setFrequency(double newFrequency);
 
-    // Get next output sample determined by the frequency and currentPhaseState.
+    // Get next output sample determined by the frequency and the current phase.
     // This also increments the state.
     double getNextSample();
 
+    // Fill a block with the next numSamples output samples
+    void fillBlock(float* dest, int numSamples);
+
+    // Move the phase forward by an angle, given as its cosine and sine. The output continues from the new phase
+    // right away. No cos() is needed here, so this is cheap enough for the audio thread.
+    void rotatePhase(double angleCos, double angleSin);
+
+    // Number of samples between the exactly calculated values
+    static constexpr int controlInterval = 32;
+
 private:
 
+    // Rotate the quadrature state to the next control point, and set up the interpolation towards it
+    void advanceToNextControlPoint();
+
     double samplerate;
     double frequency;
     
-    // current phase state should wrap around 2*pi
-    double currentPhaseState;
+    // The current phase as a point on the unit circle, i.e. cos(phase) and sin(phase)
+    double cosState;
+    double sinState;
+    
+    // The rotation that advances the phase by controlInterval samples
+    double rotationCos;
+    double rotationSin;
+    
+    // Linear interpolation between the control points
+    double currentValue;
+    double valueIncrement;
+    int samplesUntilControlPoint;
 };
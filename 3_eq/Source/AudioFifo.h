@@ -0,0 +1,72 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Passes audio from the audio thread to the editor, e.g. for drawing a spectrum, without locks or allocation.
+//
+// AbstractFifo keeps track of which part of the buffer is written and which is read, with atomic positions.
+// It gives the free space as two regions, because the free part may wrap around the end of the buffer.
+//
+// The channels are mixed to mono, the analyser doesn't need them separately. If the editor isn't open, nobody reads
+// the fifo: it fills up, and after that the new audio is simply dropped, which costs next to nothing.
+class AudioFifo
+{
+public:
+    AudioFifo(int size)
+    : fifo(size)
+    , buffer(size, 0.0f)
+    {
+    }
+
+    // Write the audio to the fifo, as much as fits. Call from the audio thread.
+    void push(const AudioBuffer<float>& audio)
+    {
+        const int numChannels = audio.getNumChannels();
+        const int numToWrite = jmin(audio.getNumSamples(), fifo.getFreeSpace());
+
+        if (numChannels == 0 || numToWrite == 0)
+            return;
+
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(numToWrite, start1, size1, start2, size2);
+
+        mixToMono(audio, 0, start1, size1);
+        mixToMono(audio, size1, start2, size2);
+
+        fifo.finishedWrite(size1 + size2);
+    }
+
+    // Read at most maxSamples from the fifo. Returns how many were read. Call from the message thread.
+    int pull(float* destination, int maxSamples)
+    {
+        const int numToRead = jmin(maxSamples, fifo.getNumReady());
+
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(numToRead, start1, size1, start2, size2);
+
+        FloatVectorOperations::copy(destination, buffer.data() + start1, size1);
+        FloatVectorOperations::copy(destination + size1, buffer.data() + start2, size2);
+
+        fifo.finishedRead(size1 + size2);
+        return size1 + size2;
+    }
+
+private:
+
+    void mixToMono(const AudioBuffer<float>& audio, int sourceStart, int destinationStart, int numSamples)
+    {
+        if (numSamples == 0)
+            return;
+
+        const float gain = 1.0f / audio.getNumChannels();
+        float* destination = buffer.data() + destinationStart;
+
+        FloatVectorOperations::copyWithMultiply(destination, audio.getReadPointer(0, sourceStart), gain, numSamples);
+
+        for (int ch = 1; ch < audio.getNumChannels(); ++ch)
+            FloatVectorOperations::addWithMultiply(destination, audio.getReadPointer(ch, sourceStart), gain, numSamples);
+    }
+
+    AbstractFifo fifo;
+    std::vector<float> buffer;
+};
@@ -0,0 +1,191 @@
+#include "BiquadEngine.h"
+
+void BiquadEngine::prepare(int numChannels, int numSectionsToUse, int maxBlockSizeToUse)
+{
+    numSections = numSectionsToUse;
+    numGroups = (numChannels + numLanes - 1) / numLanes;
+    maxBlockSize = jmax(1, maxBlockSizeToUse);
+
+    coefficients.assign(numSections, Coefficients());
+    targets.assign(numSections, Coefficients());
+
+    // Allocate one register's worth of extra elements, so that we can move to the first aligned element
+    stateStorage.assign(numSections * numGroups * 2 * numLanes + numLanes, 0.0);
+    interleavedStorage.assign(maxBlockSize * numLanes + numLanes, 0.0);
+
+    states = Vector::getNextSIMDAlignedPtr(stateStorage.data());
+    interleaved = Vector::getNextSIMDAlignedPtr(interleavedStorage.data());
+}
+
+void BiquadEngine::setTargetCoefficients(int section, const Coefficients& newCoefficients)
+{
+    targets[section] = newCoefficients;
+}
+
+void BiquadEngine::jumpToTargets()
+{
+    coefficients = targets;
+}
+
+void BiquadEngine::jumpToTarget(int section)
+{
+    coefficients[section] = targets[section];
+}
+
+void BiquadEngine::clearState(int section)
+{
+    for (int group = 0; group < numGroups; ++group)
+        std::fill(getState(section, group), getState(section, group) + 2 * numLanes, 0.0);
+}
+
+void BiquadEngine::process(float* const* channels, int numChannels, int numSamples, const Cascade* cascades, int numCascades)
+{
+    if (numCascades == 0)
+        return;
+    
+    const int numGroupsToProcess = jmin(numGroups, (numChannels + numLanes - 1) / numLanes);
+
+    // Process in pieces that fit the interleaved buffer
+    for (int start = 0; start < numSamples; start += maxBlockSize)
+    {
+        const int length = jmin(maxBlockSize, numSamples - start);
+
+        for (int group = 0; group < numGroupsToProcess; ++group)
+        {
+            interleave(channels, numChannels, group, start, length);
+
+            for (int i = 0; i < numCascades; ++i)
+                processCascade(cascades[i], group, length);
+
+            deinterleave(channels, numChannels, group, start, length);
+        }
+
+        // All groups have moved to the targets during this piece
+        for (int i = 0; i < numCascades; ++i)
+            for (int section = cascades[i].firstSection; section < cascades[i].firstSection + cascades[i].numSections; ++section)
+                jumpToTarget(section);
+    }
+}
+
+void BiquadEngine::interleave(float* const* channels, int numChannels, int group, int startSample, int numSamples)
+{
+    for (int lane = 0; lane < numLanes; ++lane)
+    {
+        const int ch = group * numLanes + lane;
+
+        // The lanes of a group without a channel are filled with silence
+        if (ch < numChannels)
+            for (int i = 0; i < numSamples; ++i)
+                interleaved[i * numLanes + lane] = channels[ch][startSample + i];
+        else
+            for (int i = 0; i < numSamples; ++i)
+                interleaved[i * numLanes + lane] = 0.0;
+    }
+}
+
+void BiquadEngine::deinterleave(float* const* channels, int numChannels, int group, int startSample, int numSamples)
+{
+    for (int lane = 0; lane < numLanes; ++lane)
+    {
+        const int ch = group * numLanes + lane;
+
+        if (ch < numChannels)
+            for (int i = 0; i < numSamples; ++i)
+                channels[ch][startSample + i] = (float) interleaved[i * numLanes + lane];
+    }
+}
+
+void BiquadEngine::processCascade(const Cascade& cascade, int group, int numSamples)
+{
+    switch (cascade.numSections)
+    {
+        case 1: processSections<1>(cascade.firstSection, group, numSamples); break;
+        case 2: processSections<2>(cascade.firstSection, group, numSamples); break;
+        case 3: processSections<3>(cascade.firstSection, group, numSamples); break;
+        case 4: processSections<4>(cascade.firstSection, group, numSamples); break;
+        default: jassertfalse; break; // longer than maxCascadeLength
+    }
+}
+
+template <int NumSections>
+void BiquadEngine::processSections(int firstSection, int group, int numSamples)
+{
+    // The coefficients, their changes per sample, and the state of each section
+    Vector G[NumSections], ff1[NumSections], ff2[NumSections], fb1[NumSections], fb2[NumSections];
+    Vector dG[NumSections], dff1[NumSections], dff2[NumSections], dfb1[NumSections], dfb2[NumSections];
+    Vector s1[NumSections], s2[NumSections];
+    
+    bool isRamping = false;
+    const double step = 1.0 / numSamples;
+    
+    for (int k = 0; k < NumSections; ++k)
+    {
+        const Coefficients& c = coefficients[firstSection + k];
+        const Coefficients& t = targets[firstSection + k];
+        
+        // Each coefficient is copied to all elements of a register, all channels use the same coefficients
+        G[k] = Vector::expand(c.G); ff1[k] = Vector::expand(c.ff1); ff2[k] = Vector::expand(c.ff2);
+        fb1[k] = Vector::expand(c.fb1); fb2[k] = Vector::expand(c.fb2);
+        
+        // Move the coefficients linearly to the targets, like in Biquad::processBlock.
+        // For the sections that aren't moving, these are all zeros.
+        dG[k] = Vector::expand((t.G - c.G) * step); dff1[k] = Vector::expand((t.ff1 - c.ff1) * step);
+        dff2[k] = Vector::expand((t.ff2 - c.ff2) * step); dfb1[k] = Vector::expand((t.fb1 - c.fb1) * step);
+        dfb2[k] = Vector::expand((t.fb2 - c.fb2) * step);
+        
+        isRamping = isRamping || (c != t);
+        
+        const double* state = getState(firstSection + k, group);
+        s1[k] = Vector::fromRawArray(state);
+        s2[k] = Vector::fromRawArray(state + numLanes);
+    }
+    
+    if (! isRamping)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            double* sample = interleaved + i * numLanes;
+            Vector x = Vector::fromRawArray(sample);
+            
+            // The same TDF-II as in Biquad::processBlock, for all channels of the group at once.
+            // The output of each section is the input of the next one.
+            for (int k = 0; k < NumSections; ++k)
+            {
+                const Vector y = G[k] * x + s1[k];
+                s1[k] = ff1[k] * x - fb1[k] * y + s2[k];
+                s2[k] = ff2[k] * x - fb2[k] * y;
+                x = y;
+            }
+            
+            x.copyToRawArray(sample);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            double* sample = interleaved + i * numLanes;
+            Vector x = Vector::fromRawArray(sample);
+            
+            for (int k = 0; k < NumSections; ++k)
+            {
+                G[k] = G[k] + dG[k]; ff1[k] = ff1[k] + dff1[k]; ff2[k] = ff2[k] + dff2[k];
+                fb1[k] = fb1[k] + dfb1[k]; fb2[k] = fb2[k] + dfb2[k];
+                
+                const Vector y = G[k] * x + s1[k];
+                s1[k] = ff1[k] * x - fb1[k] * y + s2[k];
+                s2[k] = ff2[k] * x - fb2[k] * y;
+                x = y;
+            }
+            
+            x.copyToRawArray(sample);
+        }
+    }
+    
+    for (int k = 0; k < NumSections; ++k)
+    {
+        double* state = getState(firstSection + k, group);
+        s1[k].copyToRawArray(state);
+        s2[k].copyToRawArray(state + numLanes);
+    }
+}
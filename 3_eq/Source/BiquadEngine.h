@@ -0,0 +1,91 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "biquad.hpp"
+
+// Runs a cascade of biquad sections for all channels of a buffer.
+//
+// A biquad can't be vectorised over time, since every output sample needs the previous one. But the channels are
+// independent of each other, so we can process them side by side: the left channel in one element of a SIMD register
+// and the right channel in the other. SIMDRegister<double> has 2 elements with SSE and NEON, and 4 with AVX,
+// so a stereo EQ runs both channels with a single instruction. With more channels, they're processed in groups.
+//
+// To do that, the samples are first interleaved into a temporary buffer of doubles, so that the samples of all channels
+// of a group at one time are next to each other, i.e. one SIMD register. Then each section processes the whole block
+// with its coefficients and state in registers, and finally the samples are copied back to the channels.
+//
+// The engine has a fixed number of sections, allocated in prepare, and each block processes a list of cascades.
+// A cascade is a few consecutive sections, e.g. the four sections of a 48 dB/octave filter. This way the sections
+// that aren't in use don't cost anything.
+//
+// The sections of a cascade are processed together, one sample at a time through all of them. The output of one section
+// goes straight to the next one in a register, instead of being written to memory and read back for every section.
+//
+// The data is laid out as a struct of arrays: the state of a section has one element per channel, next to each other,
+// so that it can be loaded into a register in one go.
+class BiquadEngine
+{
+public:
+    using Coefficients = Biquad<double>::Coefficients;
+    
+    // Consecutive sections that are processed together
+    struct Cascade
+    {
+        int firstSection;
+        int numSections;
+    };
+    
+    // The most sections that can be in one cascade
+    static constexpr int maxCascadeLength = 4;
+
+    // Allocates the memory, call from prepareToPlay
+    void prepare(int numChannels, int numSections, int maxBlockSize);
+
+    // Set the coefficients that the section moves to during the next block, same for all channels
+    void setTargetCoefficients(int section, const Coefficients& newCoefficients);
+
+    // Use the target coefficients of all sections right away
+    void jumpToTargets();
+    
+    // Use the target coefficients of one section right away, e.g. when it's turned on
+    void jumpToTarget(int section);
+
+    // Clear the state of a section, e.g. when its filter type changes
+    void clearState(int section);
+
+    // Process the channels in place through the listed cascades in series.
+    // The sections that aren't listed are skipped completely, they keep their state and coefficients as they were.
+    void process(float* const* channels, int numChannels, int numSamples, const Cascade* cascades, int numCascades);
+
+private:
+
+    using Vector = dsp::SIMDRegister<double>;
+    static constexpr int numLanes = (int) Vector::SIMDNumElements;
+
+    // Copy the channels of a group to the interleaved buffer, and back
+    void interleave(float* const* channels, int numChannels, int group, int startSample, int numSamples);
+    void deinterleave(float* const* channels, int numChannels, int group, int startSample, int numSamples);
+
+    // Filter the interleaved buffer with a cascade, calls the right version of processSections
+    void processCascade(const Cascade& cascade, int group, int numSamples);
+    
+    // Filter the interleaved buffer with NumSections consecutive sections.
+    // NumSections is a template argument, so that the compiler can unroll the loop over the sections.
+    template <int NumSections>
+    void processSections(int firstSection, int group, int numSamples);
+
+    // Pointer to the state s1 of a section and a group, s2 is right after it
+    double* getState(int section, int group) { return states + (section * numGroups + group) * 2 * numLanes; }
+
+    int numSections = 0;
+    int numGroups = 0;
+    int maxBlockSize = 0;
+
+    std::vector<Coefficients> coefficients;  // what the sections are using
+    std::vector<Coefficients> targets;       // what the sections move to during the next block
+
+    // SIMDRegisters are loaded from and stored to aligned memory, so these point to the first aligned element of the vectors
+    std::vector<double> stateStorage, interleavedStorage;
+    double* states = nullptr;
+    double* interleaved = nullptr;
+};
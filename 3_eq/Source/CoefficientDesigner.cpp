@@ -0,0 +1,168 @@
+#include "CoefficientDesigner.h"
+
+CoefficientDesigner::CoefficientDesigner()
+{
+    for (int i = 0; i <= numAngles; ++i)
+    {
+        const double w0 = MathConstants<double>::pi * i / numAngles;
+        angles[i] = { std::sin(w0), std::cos(w0) };
+    }
+}
+
+StringArray CoefficientDesigner::getFilterTypeNames()
+{
+    return { "Lowpass", "Peaking", "Highpass", "Bandpass", "Notch", "Allpass", "Low Shelf", "High Shelf",
+             "Butterworth LP 24", "Butterworth HP 24", "Butterworth LP 48", "Butterworth HP 48",
+             "Linkwitz-Riley LP 24", "Linkwitz-Riley HP 24", "Linkwitz-Riley LP 48", "Linkwitz-Riley HP 48" };
+}
+
+CoefficientDesigner::FilterDesign CoefficientDesigner::design(FilterType type, double frequency, double Q, double gainInDecibels, double samplerate)
+{
+    // Only the peaking and shelving filters use the gain, so leave it out of the key for the others.
+    // This way e.g. turning the gain knob of a lowpass band doesn't cause cache misses.
+    const bool usesGain = (type == FilterType::peaking || type == FilterType::lowShelf || type == FilterType::highShelf);
+    
+    if (! usesGain)
+        gainInDecibels = 0;
+    
+    // The Butterworth and Linkwitz-Riley filters have fixed Q values
+    if (type >= FilterType::butterworthLowpass24)
+        Q = 0;
+
+    const Key key { type, frequency, Q, gainInDecibels, samplerate };
+    Set& set = cache[getSetIndex(key)];
+
+    for (int i = 0; i < 2; ++i)
+    {
+        if (set.entries[i].isValid && set.entries[i].key == key)
+        {
+            ++numHits;
+            set.mostRecentlyUsed = i;
+            return set.entries[i].design;
+        }
+    }
+
+    ++numMisses;
+
+    // Replace the entry that wasn't used last
+    const int replaced = 1 - set.mostRecentlyUsed;
+    Entry& entry = set.entries[replaced];
+    set.mostRecentlyUsed = replaced;
+
+    entry.key = key;
+    entry.design = calculate(key);
+    entry.isValid = true;
+
+    return entry.design;
+}
+
+void CoefficientDesigner::clear()
+{
+    for (auto& set : cache)
+        for (auto& entry : set.entries)
+            entry.isValid = false;
+
+    numHits = 0;
+    numMisses = 0;
+}
+
+double CoefficientDesigner::getHitRate() const
+{
+    const int numDesigns = numHits + numMisses;
+    return numDesigns > 0 ? (double) numHits / numDesigns : 0.0;
+}
+
+CoefficientDesigner::FilterDesign CoefficientDesigner::calculate(const Key& key) const
+{
+    using BQ = Biquad<double>;
+    
+    const Angle angle = getAngle(key.frequency, key.samplerate);
+    const double Q = key.Q;
+    const double gain = key.gainInDecibels;
+    
+    FilterDesign design;
+    
+    switch (key.type)
+    {
+        case FilterType::lowpass:     design.sections[0] = BQ::design_lowpass_filter(angle, Q); break;
+        case FilterType::peaking:     design.sections[0] = BQ::design_peaking_filter(angle, gain, Q); break;
+        case FilterType::highpass:    design.sections[0] = BQ::design_highpass_filter(angle, Q); break;
+        case FilterType::bandpass:    design.sections[0] = BQ::design_bandpass_filter(angle, Q); break;
+        case FilterType::notch:       design.sections[0] = BQ::design_notch_filter(angle, Q); break;
+        case FilterType::allpass:     design.sections[0] = BQ::design_allpass_filter(angle, Q); break;
+        case FilterType::lowShelf:    design.sections[0] = BQ::design_lowshelf_filter(angle, gain, Q); break;
+        case FilterType::highShelf:   design.sections[0] = BQ::design_highshelf_filter(angle, gain, Q); break;
+            
+        case FilterType::butterworthLowpass24:   designButterworth(design, 0, 4, false, angle); break;
+        case FilterType::butterworthHighpass24:  designButterworth(design, 0, 4, true,  angle); break;
+        case FilterType::butterworthLowpass48:   designButterworth(design, 0, 8, false, angle); break;
+        case FilterType::butterworthHighpass48:  designButterworth(design, 0, 8, true,  angle); break;
+            
+        // Two Butterworths of half the order in series
+        case FilterType::linkwitzRileyLowpass24:
+        case FilterType::linkwitzRileyHighpass24:
+        case FilterType::linkwitzRileyLowpass48:
+        case FilterType::linkwitzRileyHighpass48:
+        {
+            const bool isHighpass = (key.type == FilterType::linkwitzRileyHighpass24 || key.type == FilterType::linkwitzRileyHighpass48);
+            const int butterworthOrder = (key.type <= FilterType::linkwitzRileyHighpass24) ? 2 : 4;
+            
+            designButterworth(design, 0, butterworthOrder, isHighpass, angle);
+            designButterworth(design, butterworthOrder / 2, butterworthOrder, isHighpass, angle);
+            break;
+        }
+    }
+    
+    return design;
+}
+
+CoefficientDesigner::Angle CoefficientDesigner::getAngle(double frequency, double samplerate) const
+{
+    const double w0 = MathConstants<double>::twoPi * frequency / samplerate;
+    
+    // Above Nyquist the biquads don't make sense anyway, but calculate them rather than read past the table
+    if (! (w0 >= 0.0 && w0 <= MathConstants<double>::pi))
+        return Biquad<double>::get_angle(frequency, samplerate);
+    
+    // The nearest point of the table, and the remainder from it in radians
+    const double position = w0 * numAngles / MathConstants<double>::pi;
+    const int index = roundToInt(position);
+    const double d = (position - index) * MathConstants<double>::pi / numAngles;
+    
+    // The Taylor series of sin and cos up to d^3 and d^4, the next terms are far below double precision
+    const double d2 = d * d;
+    const double sind = d * (1.0 - d2 / 6.0);
+    const double cosd = 1.0 - d2 / 2.0 * (1.0 - d2 / 12.0);
+    
+    const Angle& p = angles[index];
+    return { p.sinw0 * cosd + p.cosw0 * sind, p.cosw0 * cosd - p.sinw0 * sind };
+}
+
+void CoefficientDesigner::designButterworth(FilterDesign& design, int firstSection, int order, bool isHighpass, const Angle& angle)
+{
+    const int numSections = order / 2;
+    
+    // The poles of a Butterworth filter are evenly spaced on a half circle. Each section takes a pair of them,
+    // and the angle of the pair sets the Q of the section. For example, a 4th order Butterworth has Qs of 0.54 and 1.31.
+    for (int k = 0; k < numSections; ++k)
+    {
+        const double poleAngle = MathConstants<double>::pi * (2 * k + 1) / (2 * order);
+        const double Q = 1.0 / (2.0 * std::sin(poleAngle));
+        
+        design.sections[firstSection + k] = isHighpass ? Biquad<double>::design_highpass_filter(angle, Q)
+                                                       : Biquad<double>::design_lowpass_filter(angle, Q);
+    }
+    
+    design.numSections = firstSection + numSections;
+}
+
+size_t CoefficientDesigner::getSetIndex(const Key& key)
+{
+    // Combine the hashes of all parts of the key, the same way as boost::hash_combine does
+    size_t hash = std::hash<int>()((int) key.type);
+
+    for (const double value : { key.frequency, key.Q, key.gainInDecibels, key.samplerate })
+        hash ^= std::hash<double>()(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+
+    return hash & (numSets - 1);
+}
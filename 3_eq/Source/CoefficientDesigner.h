@@ -0,0 +1,136 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "biquad.hpp"
+
+// Designs biquad coefficients, and remembers the results.
+//
+// Whenever any parameter changes, the coefficients of all bands are designed again. Most of the bands haven't changed
+// though, so designing them again gives the same coefficients as the last time. The designer keeps the latest results
+// in a small cache, keyed by everything that affects the design: the filter type, frequency, Q, gain and samplerate.
+// If the same design is asked again, the coefficients are taken from the cache, without calling sin, cos or pow.
+//
+// The cache is a fixed-size table. The key is hashed to a set of two slots in the table. If neither of them has the key,
+// the new design replaces the one that was used less recently. This is called a 2-way set-associative cache.
+// With only one slot per key, two bands that happen to hash to the same slot would keep replacing each other,
+// and neither would ever be found in the cache. The cache never allocates memory, and a lookup is two comparisons.
+//
+// The hit rate tells how often the coefficients were found in the cache. The editor shows it.
+//
+// The cache only helps when the same design comes again. While a frequency is automated, every design is a new one,
+// so the misses need to be cheap too. Their slow part is sin and cos of w0, the frequency in radians per sample, so those
+// come from a table instead: sin and cos at numAngles + 1 points from 0 to pi, i.e. from 0 Hz to Nyquist.
+// Between two points, the angle addition formulas give the exact values from the nearest point p and the small remainder d:
+//
+//     sin(p + d) = sin(p) cos(d) + cos(p) sin(d)
+//     cos(p + d) = cos(p) cos(d) - sin(p) sin(d)
+//
+// d is at most half a step, so a few terms of the Taylor series give sin(d) and cos(d) to double precision. That keeps
+// even 1 - cos(w0) of a lowpass at 20 Hz accurate, which a straight line between the points wouldn't.
+class CoefficientDesigner
+{
+public:
+    using Coefficients = Biquad<double>::Coefficients;
+    using Angle = Biquad<double>::Angle;
+
+    // Fills the sin and cos table
+    CoefficientDesigner();
+
+    // The filter types, in the same order as the band type choices, see getFilterTypeNames
+    enum class FilterType
+    {
+        lowpass,
+        peaking,
+        highpass,
+        bandpass,
+        notch,
+        allpass,
+        lowShelf,
+        highShelf,
+        butterworthLowpass24,
+        butterworthHighpass24,
+        butterworthLowpass48,
+        butterworthHighpass48,
+        linkwitzRileyLowpass24,
+        linkwitzRileyHighpass24,
+        linkwitzRileyLowpass48,
+        linkwitzRileyHighpass48
+    };
+
+    // The names of the filter types for the band type parameter
+    static StringArray getFilterTypeNames();
+
+    // The steeper filters are made of several biquads in series, i.e. a cascade. Each biquad is one section.
+    // A 2nd order filter has one section and slopes 12 dB per octave, each additional section adds another 12 dB.
+    static constexpr int maxNumSections = 4;
+
+    // The coefficients of all sections of a filter
+    struct FilterDesign
+    {
+        Coefficients sections[maxNumSections];
+        int numSections = 1;
+    };
+
+    // Get the coefficients for a filter, from the cache if possible
+    FilterDesign design(FilterType type, double frequency, double Q, double gainInDecibels, double samplerate);
+
+    // Forget all cached designs and reset the statistics
+    void clear();
+
+    int getNumHits() const { return numHits; }
+    int getNumMisses() const { return numMisses; }
+
+    // The share of the designs that were found in the cache, from 0 to 1
+    double getHitRate() const;
+
+private:
+
+    struct Key
+    {
+        FilterType type;
+        double frequency, Q, gainInDecibels, samplerate;
+
+        bool operator== (const Key& other) const
+        {
+            return type == other.type && frequency == other.frequency && Q == other.Q
+                && gainInDecibels == other.gainInDecibels && samplerate == other.samplerate;
+        }
+    };
+
+    struct Entry
+    {
+        Key key;
+        FilterDesign design;
+        bool isValid = false;
+    };
+    
+    struct Set
+    {
+        Entry entries[2];
+        int mostRecentlyUsed = 0;   // index of the entry that was used last
+    };
+
+    // Calculate the coefficients without the cache
+    FilterDesign calculate(const Key& key) const;
+
+    // sin and cos of w0 from the table, see the top of this file
+    Angle getAngle(double frequency, double samplerate) const;
+
+    // A Butterworth filter of the given order, made of order / 2 lowpass or highpass sections.
+    // A Linkwitz-Riley filter is two Butterworth filters of half the order in series, so that's done with this too.
+    static void designButterworth(FilterDesign& design, int firstSection, int order, bool isHighpass, const Angle& angle);
+
+    static size_t getSetIndex(const Key& key);
+
+    // Enough for a few designs per band, a power of two so that the set is a bitwise AND of the hash
+    static constexpr size_t numSets = 128;
+
+    std::array<Set, numSets> cache;
+
+    // 8 kB per sin and cos. The steps are about 0.003 radians, so the remainder is at most 0.0015.
+    static constexpr int numAngles = 1024;
+    std::array<Angle, numAngles + 1> angles;
+
+    int numHits = 0;
+    int numMisses = 0;
+};
@@ -0,0 +1,92 @@
+#include "DynamicBand.h"
+
+void DynamicBand::design(Settings& settings, double frequency, double Q, double gain, double threshold, double ratio,
+                         double attackTime, double releaseTime, double samplerate)
+{
+    // All the filters are at the same frequency, so sin and cos of it are calculated only once
+    const auto angle = Biquad<double>::get_angle(frequency, samplerate);
+    settings.detector = Biquad<double>::design_bandpass_filter(angle, Q);
+
+    for (int i = 0; i < numGainSteps; ++i)
+        settings.gainTable[i] = Biquad<double>::design_peaking_filter(angle, minGain + i, Q);
+
+    settings.gain = (float) gain;
+    settings.threshold = (float) threshold;
+    settings.ratio = (float) ratio;
+
+    // A one-pole smoother gets about 63 % of the way to a new level in the given time
+    settings.attackCoefficient = (float) std::exp(-1000.0 / (attackTime * samplerate));
+    settings.releaseCoefficient = (float) std::exp(-1000.0 / (releaseTime * samplerate));
+}
+
+void DynamicBand::prepare(int numChannels, int maxNumSamples)
+{
+    detectors.resize(numChannels);
+    detectorBuffer.setSize(numChannels, maxNumSamples);
+    reset();
+}
+
+void DynamicBand::reset()
+{
+    for (auto& detector : detectors)
+        detector.clearState();
+
+    envelope = 0;
+    jumpToDetector = true;
+}
+
+DynamicBand::Coefficients DynamicBand::process(const Settings& settings, const float* const* channels, int numChannels, int numSamples)
+{
+    numChannels = jmin(numChannels, (int) detectors.size());
+    jassert(numSamples <= detectorBuffer.getNumSamples());
+
+    // Filter a copy of each channel through its detector. The coefficients move to the latest design during the interval.
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        detectors[ch].setTargetCoefficients(settings.detector);
+
+        if (jumpToDetector)
+            detectors[ch].jumpToTarget();
+
+        float* detectorData = detectorBuffer.getWritePointer(ch);
+        std::copy(channels[ch], channels[ch] + numSamples, detectorData);
+        detectors[ch].processBlock(detectorData, numSamples);
+    }
+
+    jumpToDetector = false;
+
+    // Follow the level of the loudest channel in the band
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float level = 0;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            level = jmax(level, std::abs(detectorBuffer.getSample(ch, i)));
+
+        const float coefficient = (level > envelope) ? settings.attackCoefficient : settings.releaseCoefficient;
+        envelope = level + coefficient * (envelope - level);
+    }
+
+    // The gain computer of a compressor: above the threshold, the output rises only 1 / ratio dB per dB of input.
+    // The difference is taken off the gain of the band.
+    const float levelInDecibels = Decibels::gainToDecibels(envelope);
+    const float overThreshold = jmax(0.0f, levelInDecibels - settings.threshold);
+    const float reduction = overThreshold * (1.0f - 1.0f / settings.ratio);
+    const float gain = jlimit((float) minGain, (float) maxGain, settings.gain - reduction);
+
+    // Interpolate linearly between the nearest two entries of the table
+    const float position = gain - minGain;
+    const int index = jmin((int) position, numGainSteps - 2);
+    const double fraction = position - index;
+
+    const Coefficients& a = settings.gainTable[index];
+    const Coefficients& b = settings.gainTable[index + 1];
+
+    Coefficients c;
+    c.G   = a.G   + fraction * (b.G   - a.G);
+    c.ff1 = a.ff1 + fraction * (b.ff1 - a.ff1);
+    c.ff2 = a.ff2 + fraction * (b.ff2 - a.ff2);
+    c.fb1 = a.fb1 + fraction * (b.fb1 - a.fb1);
+    c.fb2 = a.fb2 + fraction * (b.fb2 - a.fb2);
+    return c;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "biquad.hpp"
+
+// Turns a peaking band into a dynamic band: the gain of the band goes down when its frequency range gets loud,
+// like a compressor that only listens to and acts on one band. For example, a dynamic band at 7 kHz is a de-esser.
+//
+// The detector is a bandpass filter at the band's frequency and Q, followed by an envelope follower with attack and
+// release, like in the compressor of the dsp example. Above the threshold, the band's gain is reduced according to the ratio.
+// The bandpass runs a whole interval at a time with Biquad::processBlock, so when the band's frequency or Q is automated,
+// the detector moves to its new coefficients smoothly too.
+//
+// Designing a peaking filter needs sin, cos and pow, which is far too slow to do for every sample. So the gain is only
+// updated at a control rate, once every controlInterval samples, and the coefficients aren't designed on the audio thread
+// at all. Instead, the message thread designs a table of coefficients for every decibel of gain in advance, and the
+// audio thread interpolates between the two nearest entries. The biquad engine then moves to the new coefficients linearly
+// during the next interval, so the gain changes smoothly. Interpolating between two stable biquads of the same frequency
+// and Q always gives a stable biquad, so this can't blow up.
+class DynamicBand
+{
+public:
+    using Coefficients = Biquad<double>::Coefficients;
+
+    // The gain is updated every this many samples, at the normal samplerate
+    static constexpr int controlInterval = 32;
+
+    // The gain table covers the whole gain range of the bands, in steps of one decibel
+    static constexpr int minGain = -30;
+    static constexpr int maxGain = 30;
+    static constexpr int numGainSteps = maxGain - minGain + 1;
+
+    // Everything the audio thread needs for a dynamic band, designed on the message thread
+    struct Settings
+    {
+        Coefficients detector;               // the bandpass filter of the detector
+        Coefficients gainTable[numGainSteps];   // the peaking filter for each gain from minGain to maxGain
+
+        float gain = 0;                      // the gain of the band below the threshold, in decibels
+        float threshold = 0;                 // in decibels
+        float ratio = 1;
+        float attackCoefficient = 0;         // how much of the old envelope is kept per sample, when it's rising
+        float releaseCoefficient = 0;        // ... and when it's falling
+    };
+
+    // Fill in the settings, on the message thread.
+    // The filters run at samplerate, and the attack and release times are in milliseconds.
+    static void design(Settings& settings, double frequency, double Q, double gain, double threshold, double ratio,
+                       double attackTime, double releaseTime, double samplerate);
+
+    // Allocates the detector filters and their output buffers, call from prepareToPlay.
+    // maxNumSamples is the longest interval that process is called with.
+    void prepare(int numChannels, int maxNumSamples);
+
+    // Start again from silence, e.g. when the band is turned on
+    void reset();
+
+    // Run the detector over the next numSamples of the input, and return the coefficients of the band for its current level
+    Coefficients process(const Settings& settings, const float* const* channels, int numChannels, int numSamples);
+
+private:
+
+    // One detector filter for each channel. The channels are linked: the loudest one drives the gain of all of them.
+    std::vector<Biquad<double>> detectors;
+    float envelope = 0;
+
+    // The input doesn't change, so the detectors filter a copy of it
+    AudioBuffer<float> detectorBuffer;
+
+    // After a reset there are no old coefficients to move from
+    bool jumpToDetector = true;
+};
@@ -1,46 +1,34 @@
 #include "FilterBand.h"
 
-void FilterBand::prepare(int numChannels)
+CoefficientDesigner::FilterDesign FilterBand::designCoefficients(CoefficientDesigner& designer, int oversamplingFactor) const
 {
-    // Allocate required number of biquads
-    if (numChannels != biquads.size())
-        biquads.resize(numChannels);
+    const float freq = freqParam->get();
+    const float qual = qualParam->get();
+    const float gain = gainParam->get();
+    
+    // The band type choices are in the same order as the designer's filter types
+    const auto type = static_cast<CoefficientDesigner::FilterType>(typeParam->getIndex());
     
-    parameterValueChanged(0, 0);
+    return designer.design(type, freq, qual, gain, samplerate * oversamplingFactor);
+}
+
+bool FilterBand::isDynamic() const
+{
+    return dynamicParam->get() && static_cast<CoefficientDesigner::FilterType>(typeParam->getIndex()) == CoefficientDesigner::FilterType::peaking;
+}
+
+void FilterBand::designDynamics(DynamicBand::Settings& settings, int oversamplingFactor) const
+{
+    DynamicBand::design(settings, freqParam->get(), qualParam->get(), gainParam->get(), thresholdParam->get(), ratioParam->get(),
+                        attackParam->get(), releaseParam->get(), samplerate * oversamplingFactor);
 }
 
 // This function is called when values change
 void FilterBand::parameterValueChanged (int parameterIndex, float newValue)
 {
-    const float freq = freqParam->get();
-    const float qual = qualParam->get();
-    const float gain = gainParam->get();
-    
-    const bool bandTypeChanged = (parameterIndex == typeParam->getParameterIndex());
+    if (parameterIndex == typeParam->getParameterIndex())
+        ++typeChangeCount; // clear state only if band type was changed
     
-    if (typeParam->getIndex() == 0)
-    {
-        for (int ch = 0; ch < biquads.size(); ++ch)
-        {
-            biquads[ch].design_lowpass_filter(freq, qual, samplerate);
-            
-            if (bandTypeChanged)
-                biquads[ch].clearState(); // clear state only if band type was changed
-        }
-    }
-    else if (typeParam->getIndex() == 1)
-    {
-        for (int ch = 0; ch < biquads.size(); ++ch)
-        {
-            biquads[ch].design_peaking_filter(freq, gain, qual, samplerate);
-            
-            if (bandTypeChanged)
-                biquads[ch].clearState();
-        }
-    }
-    else
-    {
-        // We shouldn't be here, somethings gone terribly wrong
-        jassertfalse;
-    }
+    // Many parameters can change before the message thread gets to it, but the coefficients are designed only once
+    updater.triggerAsyncUpdate();
 }
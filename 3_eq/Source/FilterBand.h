@@ -1,6 +1,10 @@
+#pragma once
+
 #include <JuceHeader.h>
 
 #include "biquad.hpp"
+#include "CoefficientDesigner.h"
+#include "DynamicBand.h"
 
 // A helper struct to keep everything that we need for a single EQ band together
 //
@@ -22,8 +26,13 @@ struct FilterBand : public AudioProcessorParameter::Listener
     // This tells the compiler that "something" will be put here, and it'll try to sort it out after reading
     // all the files.
     //
+    // When any parameter of the band changes, the band triggers the coefficientUpdater,
+    // which designs the new coefficients later on the message thread.
     template <class AudioProcessorType>
-    FilterBand(AudioProcessorType& processor, const String bandName, float defaultFreq, int defaultType, double& fs) : samplerate(fs)
+    FilterBand(AudioProcessorType& processor, const String bandName, float defaultFreq, int defaultType, bool defaultEnabled,
+               double& fs, AsyncUpdater& coefficientUpdater)
+    : samplerate(fs)
+    , updater(coefficientUpdater)
     {
         const String bandId = bandName.replace(" ", "").toLowerCase(); // just in case
     
@@ -38,28 +47,59 @@ struct FilterBand : public AudioProcessorParameter::Listener
         gainParam = new AudioParameterFloat (bandId + "gain", bandName + " Gain", -30, 30, 0);
     
         // Band type is a choice parameter. Google for docs.
-        // To add more band types, add them to the list of types, and implement their respective design functions into parameterValueChanged
-        typeParam = new AudioParameterChoice (bandId + "type", bandName + " Type", { "Lowpass", "Peaking", }, defaultType);
+        // To add more band types, add them to the filter types of CoefficientDesigner, and implement their design functions there
+        typeParam = new AudioParameterChoice (bandId + "type", bandName + " Type", CoefficientDesigner::getFilterTypeNames(), defaultType);
+    
+        // A band that is turned off isn't processed at all, so unused bands don't cost anything
+        enabledParam = new AudioParameterBool (bandId + "enabled", bandName + " On", defaultEnabled);
+    
+        // The dynamics work like the compressor in the dsp example, see DynamicBand.
+        // Only peaking bands can be dynamic, and only in the minimum phase mode.
+        dynamicParam = new AudioParameterBool (bandId + "dynamic", bandName + " Dynamic", false);
+        thresholdParam = new AudioParameterFloat (bandId + "threshold", bandName + " Threshold (dB)", -60, 0, -20);
+        ratioParam = new AudioParameterFloat (bandId + "ratio", bandName + " Ratio", 1, 20, 4);
+        attackParam = new AudioParameterFloat (bandId + "attack", bandName + " Attack (ms)", 1, 30, 12);
+        releaseParam = new AudioParameterFloat (bandId + "release", bandName + " Release (ms)", 1, 300, 150);
     
         // Add the newly created parameters to the audio processor
         processor.addParameter(freqParam);
         processor.addParameter(qualParam);
         processor.addParameter(gainParam);
         processor.addParameter(typeParam);
+        processor.addParameter(enabledParam);
+        processor.addParameter(dynamicParam);
+        processor.addParameter(thresholdParam);
+        processor.addParameter(ratioParam);
+        processor.addParameter(attackParam);
+        processor.addParameter(releaseParam);
     
         // register as listener
         freqParam->addListener(this);
         qualParam->addListener(this);
         gainParam->addListener(this);
         typeParam->addListener(this);
+        enabledParam->addListener(this);
+        dynamicParam->addListener(this);
+        thresholdParam->addListener(this);
+        ratioParam->addListener(this);
+        attackParam->addListener(this);
+        releaseParam->addListener(this);
     }
 
     FilterBand() = delete; // this means that a filter band can't be created with the so-called default constructor which has no parameters
 
-    // We'll call this function in prepareToPlay(), it allocates our biquads
-    void prepare(int numChannels);
+    // Design the coefficients from the current parameter values, for a filter that runs at samplerate * oversamplingFactor.
+    // This may call sin, cos and pow, so it's called on the message thread, not on the audio thread.
+    CoefficientDesigner::FilterDesign designCoefficients(CoefficientDesigner& designer, int oversamplingFactor) const;
+    
+    // True if the band is a peaking band with the dynamics turned on
+    bool isDynamic() const;
+    
+    // Design the gain table and the detector of a dynamic band, also on the message thread
+    void designDynamics(DynamicBand::Settings& settings, int oversamplingFactor) const;
 
-    // This function is called when values change
+    // This function is called when values change. It can be called on any thread, even on the audio thread,
+    // so it doesn't do any of the work itself, it only asks the processor to update the coefficients.
     // We don't actually need the parameterIndex and newValue here, so commenting the names out removes "parameter unused" compiler warning
     void parameterValueChanged (int /* parameterIndex */, float /* newValue */) override;
     
@@ -67,19 +107,22 @@ struct FilterBand : public AudioProcessorParameter::Listener
     // Just implement with empty body for now.
     void parameterGestureChanged (int parameterIndex, bool gestureIsStarting) override {}
 
-    // The actual EQ state
-    // Store the biquads into the processor state. Since the filter has a state that should be
-    // carried over form block to block, we can't just create a new filter in every block.
-    //
-    // To make this more general, we're storing the biquads into a vector and allocate the memory for them.
-    std::vector<Biquad<double>> biquads;
+    // Counts the changes of the band type. The audio thread clears the state of the band's filter when it sees a new count.
+    std::atomic<int> typeChangeCount { 0 };
     
     // Parameters that the band needs
     AudioParameterFloat* freqParam;
     AudioParameterFloat* qualParam;
     AudioParameterFloat* gainParam;
     AudioParameterChoice* typeParam;
+    AudioParameterBool* enabledParam;
+    AudioParameterBool* dynamicParam;
+    AudioParameterFloat* thresholdParam;
+    AudioParameterFloat* ratioParam;
+    AudioParameterFloat* attackParam;
+    AudioParameterFloat* releaseParam;
     
     double& samplerate; // let's store a reference of samplerate that the AudioProcessor maintains
+    AsyncUpdater& updater;
 };
 
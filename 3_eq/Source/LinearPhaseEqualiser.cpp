@@ -0,0 +1,241 @@
+#include "LinearPhaseEqualiser.h"
+
+LinearPhaseEqualiser::LinearPhaseEqualiser()
+: Thread("Linear phase EQ")
+{
+}
+
+LinearPhaseEqualiser::~LinearPhaseEqualiser()
+{
+    stopThread(1000);
+}
+
+void LinearPhaseEqualiser::prepare(const dsp::ProcessSpec& spec, int newPartitionSize)
+{
+    // The background thread uses everything below, so stop it while they change
+    stopThread(1000);
+
+    // The audio isn't running either, so take a convolution that wasn't swapped in yet into use right here
+    if (hasNewConvolution)
+    {
+        std::swap(convolution, nextConvolution);
+        hasNewConvolution = false;
+    }
+
+    nextConvolution.reset();
+
+    if (convolution == nullptr || newPartitionSize != latestPartitionSize)
+        convolution.reset(new dsp::Convolution(dsp::Convolution::Latency { newPartitionSize }));
+
+    latestPartitionSize = newPartitionSize;
+    partitionSize = newPartitionSize;
+    pendingPartitionSize = newPartitionSize;
+
+    processSpec = spec;
+    samplerate = spec.sampleRate;
+
+    // About 85 ms of kernel, e.g. 4096 samples at 44.1 and 48 kHz. That gives a frequency resolution of about 12 Hz,
+    // which is enough for all but the narrowest bands at the lowest frequencies.
+    kernelSize = nextPowerOfTwo((int) (samplerate / 12));
+    fft.reset(new dsp::FFT(roundToInt(std::log2(kernelSize))));
+
+    // The real-only FFT works in place, and needs room for the complex spectrum, i.e. twice the size
+    fftData.assign(2 * kernelSize, 0.0f);
+
+    // The output of the old convolution while it's crossfaded to a new one
+    crossfadeBuffer.setSize((int) spec.numChannels, (int) spec.maximumBlockSize);
+
+    convolution->prepare(spec);
+
+    startThread();
+}
+
+void LinearPhaseEqualiser::setPartitionSize(int newPartitionSize)
+{
+    const ScopedLock lock(designLock);
+    pendingPartitionSize = newPartitionSize;
+    partitionSize = newPartitionSize;
+}
+
+int LinearPhaseEqualiser::getLatencyInSamples() const
+{
+    // dsp::Convolution's latency is the partition size, as long as it's a power of two of at least 64
+    return partitionSize + kernelSize / 2;
+}
+
+void LinearPhaseEqualiser::setDesigns(const std::vector<FilterDesign>& designs, double designSamplerate)
+{
+    {
+        const ScopedLock lock(designLock);
+        pendingDesigns = designs;
+        pendingDesignSamplerate = designSamplerate;
+    }
+
+    // Wake up the background thread. If it's busy, it makes another kernel right after the current one.
+    notify();
+}
+
+void LinearPhaseEqualiser::reset()
+{
+    convolution->reset();
+}
+
+void LinearPhaseEqualiser::process(AudioBuffer<float>& buffer)
+{
+    dsp::AudioBlock<float> block (buffer);
+
+    // If the background thread has built a convolution with a new partition size, and isn't handing over another one
+    // right now, take it into use. The old one stays in nextConvolution, so it isn't deleted on the audio thread.
+    {
+        const SpinLock::ScopedTryLockType lock(swapLock);
+
+        if (lock.isLocked() && hasNewConvolution)
+        {
+            std::swap(convolution, nextConvolution);
+            hasNewConvolution = false;
+
+            // The lock is still held, so the background thread can't delete the old one while it runs here
+            crossfadeToNewConvolution(block);
+            return;
+        }
+    }
+
+    convolution->process(dsp::ProcessContextReplacing<float> (block));
+}
+
+void LinearPhaseEqualiser::crossfadeToNewConvolution(dsp::AudioBlock<float>& block)
+{
+    // Run the old convolution once more on a copy of the input, as much of it as the buffer from prepare holds
+    const int numSamples = (int) block.getNumSamples();
+    const int numToFade = jmin(numSamples, crossfadeBuffer.getNumSamples());
+
+    auto oldBlock = dsp::AudioBlock<float> (crossfadeBuffer).getSubsetChannelBlock(0, block.getNumChannels())
+                                                             .getSubBlock(0, (size_t) numToFade);
+    oldBlock.copyFrom(block);
+    nextConvolution->process(dsp::ProcessContextReplacing<float> (oldBlock));
+
+    convolution->process(dsp::ProcessContextReplacing<float> (block));
+
+    // Fade linearly from the old output to the new one
+    for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+    {
+        float* data = block.getChannelPointer(ch);
+        const float* oldData = oldBlock.getChannelPointer(ch);
+
+        for (int i = 0; i < numToFade; ++i)
+        {
+            const float fade = (float) (i + 1) / (float) numToFade;
+            data[i] = oldData[i] + fade * (data[i] - oldData[i]);
+        }
+    }
+}
+
+void LinearPhaseEqualiser::run()
+{
+    while (! threadShouldExit())
+    {
+        wait(-1);
+
+        if (threadShouldExit())
+            return;
+
+        renderKernel();
+    }
+}
+
+void LinearPhaseEqualiser::renderKernel()
+{
+    double designSamplerate;
+    int newPartitionSize;
+    {
+        const ScopedLock lock(designLock);
+        renderedDesigns = pendingDesigns;
+        designSamplerate = pendingDesignSamplerate;
+        newPartitionSize = pendingPartitionSize;
+    }
+
+    // The magnitude of the whole EQ at each bin, from 0 Hz to Nyquist.
+    // The phase is zero, so the imaginary parts are zeros.
+    for (int bin = 0; bin <= kernelSize / 2; ++bin)
+    {
+        const double frequency = bin * samplerate / kernelSize;
+        double magnitude = 1.0;
+
+        for (const auto& design : renderedDesigns)
+            for (int k = 0; k < design.numSections; ++k)
+                magnitude *= Biquad<double>::get_magnitude(design.sections[k], frequency, designSamplerate);
+
+        fftData[2 * bin] = (float) magnitude;
+        fftData[2 * bin + 1] = 0.0f;
+    }
+
+    fft->performRealOnlyInverseTransform(fftData.data());
+
+    // The zero phase impulse response is centered around the first sample, and wraps around: the samples before it
+    // are at the end. Rotating it by half the length puts the center in the middle, where the Hann window is 1,
+    // and the window fades the kernel to zero towards both ends.
+    AudioBuffer<float> kernel (1, kernelSize);
+    float* kernelData = kernel.getWritePointer(0);
+
+    for (int i = 0; i < kernelSize; ++i)
+    {
+        const float window = 0.5f - 0.5f * std::cos(MathConstants<float>::twoPi * i / kernelSize);
+        kernelData[i] = fftData[(i + kernelSize / 2) % kernelSize] * window;
+    }
+
+    // A new partition size needs a new convolution. So does a convolution that the audio thread hasn't taken yet:
+    // it got its kernel when it was built, and a kernel loaded into it now would arrive after the swap.
+    bool isNewConvolutionWaiting;
+    {
+        const SpinLock::ScopedLockType lock(swapLock);
+        isNewConvolutionWaiting = hasNewConvolution;
+    }
+
+    if (newPartitionSize != latestPartitionSize || isNewConvolutionWaiting)
+    {
+        buildConvolution(newPartitionSize, std::move(kernel));
+        return;
+    }
+
+    // The audio thread keeps using this convolution, and dsp::Convolution crossfades to the new kernel by itself
+    loadKernel(*convolution, std::move(kernel));
+}
+
+void LinearPhaseEqualiser::loadKernel(dsp::Convolution& target, AudioBuffer<float>&& kernel)
+{
+    // Same kernel for all channels, and it's at the processing samplerate so it doesn't need resampling
+    target.loadImpulseResponse(std::move(kernel), samplerate, dsp::Convolution::Stereo::no,
+                               dsp::Convolution::Trim::no, dsp::Convolution::Normalise::no);
+}
+
+void LinearPhaseEqualiser::buildConvolution(int newPartitionSize, AudioBuffer<float>&& kernel)
+{
+    // Build and prepare the new convolution before taking the lock, since that's what allocates
+    std::unique_ptr<dsp::Convolution> newConvolution (new dsp::Convolution(dsp::Convolution::Latency { newPartitionSize }));
+
+    // loadImpulseResponse only queues the kernel, and prepare takes the queued kernel into use right away. If the loading
+    // thread of dsp::Convolution got to it first, prepare can miss it, so prepare again until the kernel is there.
+    // Nothing else uses this convolution yet, so that's safe, and the audio thread never gets one without the EQ.
+    loadKernel(*newConvolution, std::move(kernel));
+    newConvolution->prepare(processSpec);
+
+    while (newConvolution->getCurrentIRSize() != kernelSize)
+    {
+        if (threadShouldExit())
+            return;
+
+        sleep(1);
+        newConvolution->prepare(processSpec);
+    }
+
+    latestPartitionSize = newPartitionSize;
+
+    {
+        const SpinLock::ScopedLockType lock(swapLock);
+        std::swap(nextConvolution, newConvolution);
+        hasNewConvolution = true;
+    }
+
+    // newConvolution now has what was in nextConvolution: the one that the audio thread swapped out, or one that it never
+    // got to use. Neither is used any more, so it's deleted here, on the background thread.
+}
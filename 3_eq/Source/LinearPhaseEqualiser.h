@@ -0,0 +1,98 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "CoefficientDesigner.h"
+
+// Filters the audio with the same magnitude response as the biquad bands, but without their phase shift.
+//
+// A biquad shifts the phase of the frequencies around its center frequency, i.e. some frequencies are delayed more
+// than others. A linear phase EQ delays all frequencies by the same amount instead, so that only the magnitudes change.
+// That can't be done with biquads: it has to be a long FIR filter, i.e. an impulse response that the audio is convolved with.
+//
+// The impulse response, or kernel, is made from the magnitude responses of the bands. The magnitudes of all sections of
+// all bands are multiplied together at each FFT bin, and the inverse FFT of that is a zero phase impulse response. It's
+// shifted by half its length so that it starts at zero, and a window fades out its ends. That's thousands of sin and cos
+// calls and an FFT, so it's done on a background thread of its own, not on the message thread or the audio thread.
+//
+// The convolution itself is done by dsp::Convolution. It splits the kernel into partitions of equal size, and convolves
+// each partition with an FFT. The partition size is also the latency of the convolution: bigger partitions need less CPU,
+// but delay the audio more. When a new kernel is loaded, dsp::Convolution crossfades from the old one to the new one,
+// so that changing the EQ doesn't click.
+//
+// The partition size can't be changed in a dsp::Convolution, so a new size means a new dsp::Convolution. Building one
+// allocates, so it's done on the background thread too, and it's handed to the audio thread only once the kernel is
+// installed in it. The audio thread swaps it in at the start of a block, runs both convolutions during that block and
+// crossfades from the old output to the new one. The old one is deleted on the background thread when the next one is
+// built. The new convolution has a different latency, so the change can still be heard once, like in any plug-in
+// that changes its latency.
+class LinearPhaseEqualiser : private Thread
+{
+public:
+    using FilterDesign = CoefficientDesigner::FilterDesign;
+
+    LinearPhaseEqualiser();
+    ~LinearPhaseEqualiser() override;
+
+    // Allocates everything and starts the background thread, call from prepareToPlay
+    void prepare(const dsp::ProcessSpec& spec, int partitionSize);
+
+    // The convolution with the new partition size is built together with the next kernel, i.e. call setDesigns after this.
+    // Call from the message thread.
+    void setPartitionSize(int newPartitionSize);
+
+    // The delay of the processed audio in samples: the convolution, and half of the kernel.
+    // Uses the latest partition size, the host is told about it right away even though the new convolution takes a moment.
+    int getLatencyInSamples() const;
+
+    // Give the designs of the bands that are turned on, designed for designSamplerate, which may be higher than the
+    // samplerate if the bands are designed for oversampling. The kernel is made on the background thread, and loaded
+    // when it's ready. Call from the message thread.
+    void setDesigns(const std::vector<FilterDesign>& designs, double designSamplerate);
+
+    // Clear the old audio from the convolution, e.g. when the linear phase mode is turned on
+    void reset();
+
+    // Convolve the channels in place, call from the audio thread
+    void process(AudioBuffer<float>& buffer);
+
+private:
+
+    // The background thread waits until it's notified of new designs, and then makes the kernel
+    void run() override;
+    void renderKernel();
+    void loadKernel(dsp::Convolution& target, AudioBuffer<float>&& kernel);
+    void buildConvolution(int newPartitionSize, AudioBuffer<float>&& kernel);
+    void crossfadeToNewConvolution(dsp::AudioBlock<float>& block);
+
+    // The convolution that the audio thread uses
+    std::unique_ptr<dsp::Convolution> convolution;
+
+    // A new convolution for the audio thread to swap in when hasNewConvolution is set. After the swap it has the old one,
+    // which waits here until the background thread deletes it. The audio thread only tries the lock, so it never waits.
+    std::unique_ptr<dsp::Convolution> nextConvolution;
+    bool hasNewConvolution = false;
+    SpinLock swapLock;
+
+    // The partition size of the newest one of the two
+    int latestPartitionSize = 0;
+
+    // The output of the old convolution during the block in which the new one is swapped in
+    AudioBuffer<float> crossfadeBuffer;
+
+    dsp::ProcessSpec processSpec { 44100, 0, 0 };
+    int partitionSize = 0;
+    int kernelSize = 0;
+    double samplerate = 44100;
+
+    // The latest designs and partition size from the message thread. The background thread copies them before it starts
+    // working, so that the message thread can give new ones in the meantime.
+    CriticalSection designLock;
+    std::vector<FilterDesign> pendingDesigns, renderedDesigns;
+    double pendingDesignSamplerate = 44100;
+    int pendingPartitionSize = 0;
+
+    std::unique_ptr<dsp::FFT> fft;
+    std::vector<float> fftData;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LinearPhaseEqualiser)
+};
@@ -10,13 +10,16 @@
 #include "PluginEditor.h"
 
 EqBandComponent::EqBandComponent(FilterBand& band)
-: freqSlider(Slider::RotaryVerticalDrag, Slider::TextBoxBelow)
+: enabledButton(band.enabledParam->name)
+, freqSlider(Slider::RotaryVerticalDrag, Slider::TextBoxBelow)
 , qualSlider(Slider::RotaryVerticalDrag, Slider::TextBoxBelow)
 , gainSlider(Slider::RotaryVerticalDrag, Slider::TextBoxBelow)
+, enabledAttachment(*band.enabledParam, enabledButton)
 , freqAttachment(*band.freqParam, freqSlider)
 , qualAttachment(*band.qualParam, qualSlider)
 , gainAttachment(*band.gainParam, gainSlider)
 {
+    addAndMakeVisible(enabledButton);
     addAndMakeVisible(freqSlider);
     addAndMakeVisible(qualSlider);
     addAndMakeVisible(gainSlider);
@@ -29,6 +32,8 @@ void EqBandComponent::paint(juce::Graphics& g)
 void EqBandComponent::resized()
 {
     auto bounds = getLocalBounds();
+    enabledButton.setBounds(bounds.removeFromLeft(100));
+    
     const int third = bounds.getWidth() / 3;
     
     freqSlider.setBounds(bounds.removeFromLeft(third));
@@ -44,16 +49,35 @@ void EqBandComponent::resized()
 EqualiserAudioProcessorEditor::EqualiserAudioProcessorEditor (EqualiserAudioProcessor& p)
 : AudioProcessorEditor (&p)
 , audioProcessor (p)
-, bandKnobs0(p.band0)
-, bandKnobs1(p.band1)
+, spectrumDisplay (p)
 {
-    addAndMakeVisible(bandKnobs0);
-    addAndMakeVisible(bandKnobs1);
-    setSize (400, 300);
+    addAndMakeVisible(spectrumDisplay);
+    addAndMakeVisible(cacheLabel);
+    
+    for (auto* band : p.bands)
+    {
+        auto* bandComponent = bandComponents.add(new EqBandComponent(*band));
+        addAndMakeVisible(bandComponent);
+    }
+    
+    // The display is 200 pixels high, the cache label 20, and each band gets a row that is 60 pixels high
+    setSize (500, 200 + 20 + 60 * bandComponents.size());
+    
+    timerCallback();
+    startTimerHz(2);
 }
 
 EqualiserAudioProcessorEditor::~EqualiserAudioProcessorEditor()
 {
+    stopTimer();
+}
+
+void EqualiserAudioProcessorEditor::timerCallback()
+{
+    const auto& designer = audioProcessor.getCoefficientDesigner();
+    
+    cacheLabel.setText("Coefficient cache: " + String(roundToInt(designer.getHitRate() * 100)) + "% hits, "
+                       + String(designer.getNumHits() + designer.getNumMisses()) + " designs", dontSendNotification);
 }
 
 void EqualiserAudioProcessorEditor::paint (juce::Graphics& g)
@@ -64,7 +88,11 @@ void EqualiserAudioProcessorEditor::paint (juce::Graphics& g)
 void EqualiserAudioProcessorEditor::resized()
 {
     auto bounds = getLocalBounds();
-    int h = bounds.getHeight() / 2;
-    bandKnobs0.setBounds(bounds.removeFromTop(h));
-    bandKnobs1.setBounds(bounds);
+    spectrumDisplay.setBounds(bounds.removeFromTop(200));
+    cacheLabel.setBounds(bounds.removeFromTop(20));
+    
+    const int h = bounds.getHeight() / jmax(1, bandComponents.size());
+    
+    for (auto* bandComponent : bandComponents)
+        bandComponent->setBounds(bounds.removeFromTop(h));
 }
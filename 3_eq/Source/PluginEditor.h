@@ -2,6 +2,7 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "SpectrumDisplay.h"
 
 // A helper class to contain Sliders and attachments for a single band
 struct EqBandComponent : public Component
@@ -11,16 +12,20 @@ struct EqBandComponent : public Component
     void paint (juce::Graphics& g) override;
     void resized() override;
 
+    ToggleButton enabledButton;
     Slider freqSlider;
     Slider qualSlider;
     Slider gainSlider;
     
+    ButtonParameterAttachment enabledAttachment;
     SliderParameterAttachment freqAttachment;
     SliderParameterAttachment qualAttachment;
     SliderParameterAttachment gainAttachment;
 };
 
-class EqualiserAudioProcessorEditor  : public juce::AudioProcessorEditor
+// A timer updates the hit rate of the coefficient cache twice per second, the label only repaints when the text changes
+class EqualiserAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                       private Timer
 {
 public:
     EqualiserAudioProcessorEditor (EqualiserAudioProcessor&);
@@ -31,10 +36,18 @@ public:
     void resized() override;
 
 private:
+    void timerCallback() override;
+    
     EqualiserAudioProcessor& audioProcessor;
     
-    EqBandComponent bandKnobs0;
-    EqBandComponent bandKnobs1;
+    // The spectrum and the response of the EQ, above the bands
+    SpectrumDisplay spectrumDisplay;
+    
+    // How often the designs of the bands come from the cache, see CoefficientDesigner
+    Label cacheLabel;
+    
+    // One row of knobs for each band
+    OwnedArray<EqBandComponent> bandComponents;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EqualiserAudioProcessorEditor)
 };
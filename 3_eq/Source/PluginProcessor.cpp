@@ -3,15 +3,52 @@
 
 
 //==============================================================================
-EqualiserAudioProcessor::EqualiserAudioProcessor()
+EqualiserAudioProcessor::EqualiserAudioProcessor(int numBandsToUse)
 : AudioProcessor (BusesProperties().withInput  ("Input",  juce::AudioChannelSet::stereo(), true).withOutput ("Output", juce::AudioChannelSet::stereo(), true))
-, band0(*this, "Band 0", 1000, /* lowpass */ 0, samplerate) // call the constructors of FilterBands on initialisation
-, band1(*this, "Band 1", 4000, /* peaking */ 1, samplerate)
+, numBands (jlimit(minNumBands, maxNumBands, numBandsToUse))
 {
+    // The first two bands are a lowpass and a peaking band, like in the first version of this EQ.
+    // The rest are peaking bands spread evenly on a logarithmic scale from 50 Hz to 12 kHz, and turned off.
+    for (int i = 0; i < numBands; ++i)
+    {
+        const bool isLowpass = (i == 0);
+        const float defaultFreq = (i == 0) ? 1000.0f : (i == 1) ? 4000.0f : 50.0f * std::pow(240.0f, (float) (i - 2) / (numBands - 3));
+        const int defaultType = isLowpass ? /* lowpass */ 0 : /* peaking */ 1;
+        const bool defaultEnabled = (i < 2);
+        
+        bands.add(new FilterBand(*this, "Band " + String(i), defaultFreq, defaultType, defaultEnabled, samplerate, *this));
+    }
+    
+    oversamplingParam = new AudioParameterChoice ("oversampling", "Oversampling", { "Off", "2x", "4x" }, 0);
+    addParameter(oversamplingParam);
+    oversamplingParam->addListener(this);
+    
+    phaseParam = new AudioParameterChoice ("phase", "Phase", { "Minimum", "Linear" }, 0);
+    addParameter(phaseParam);
+    phaseParam->addListener(this);
+    
+    partitionSizeParam = new AudioParameterChoice ("partitionsize", "Partition Size", { "256", "512", "1024", "2048" }, 2);
+    addParameter(partitionSizeParam);
+    partitionSizeParam->addListener(this);
+    
+    enabledDesigns.reserve(numBands);
+    
+    // Reserve the memory for the list, so that rebuilding it on the audio thread doesn't allocate
+    activeCascades.reserve(numBands);
+    bandIsActive.resize(numBands, false);
+    bandTypeChangeCounts.resize(numBands, 0);
+    dynamicBands.resize(numBands);
+    activeDynamicBands.reserve(numBands);
+    
+    // All three copies of the settings get a place for every band
+    EqSettings initialSettings;
+    initialSettings.bands.resize(numBands);
+    settingsBuffer.fill(initialSettings);
 }
 
 EqualiserAudioProcessor::~EqualiserAudioProcessor()
 {
+    cancelPendingUpdate();
 }
 
 //==============================================================================
@@ -67,13 +104,215 @@ void EqualiserAudioProcessor::changeProgramName (int index, const juce::String&
 //==============================================================================
 void EqualiserAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    // store this for later use
-    this->samplerate = sampleRate;
-    
     int numChannels = getTotalNumInputChannels();
     
-    band0.prepare(numChannels);
-    band1.prepare(numChannels);
+    // Each band has its own sections in the engine, in the order that they run in.
+    // When oversampling, the engine gets blocks that are longer than samplesPerBlock.
+    static_assert(CoefficientDesigner::maxNumSections <= BiquadEngine::maxCascadeLength, "The engine can't process the longest filters");
+    engine.prepare(numChannels, numBands * CoefficientDesigner::maxNumSections, samplesPerBlock << maxOversamplingOrder);
+    oversampledChannels.resize(numChannels);
+    intervalChannels.resize(numChannels);
+    
+    // The dynamic bands get an interval at a time, which is longer when oversampling
+    for (auto& dynamicBand : dynamicBands)
+        dynamicBand.prepare(numChannels, DynamicBand::controlInterval << maxOversamplingOrder);
+    
+    // The audio isn't running during prepareToPlay, so we can design the coefficients right here
+    // and pick them up right away, so that the first block starts with the right ones
+    {
+        const ScopedLock lock(publishLock);
+        
+        // The polyphase IIR half-band filters are much cheaper than the linear phase FIR ones, and have less latency.
+        // Their phase shift is small in the audible range, and an EQ shifts the phase anyway.
+        // Integer latency adds a small delay so that the latency is a whole number of samples that we can report to the host.
+        for (int i = 0; i < maxOversamplingOrder; ++i)
+        {
+            oversamplers[i].reset(new dsp::Oversampling<float> (numChannels, i + 1, dsp::Oversampling<float>::filterHalfBandPolyphaseIIR, true, true));
+            oversamplers[i]->initProcessing(samplesPerBlock);
+        }
+        
+        oversamplerBlockSize = samplesPerBlock;
+        
+        // The partition sizes are 256, 512, 1024 and 2048
+        const int partitionSize = 256 << partitionSizeParam->getIndex();
+        linearPhase.prepare({ sampleRate, (uint32) samplesPerBlock, (uint32) numChannels }, partitionSize);
+        
+        // store this for later use, the lock keeps the message thread from designing with a half-changed samplerate
+        this->samplerate = sampleRate;
+        publishSettings();
+    }
+    
+    // Start with all bands off, so that applySettings turns on the enabled ones from a clean state
+    std::fill(bandIsActive.begin(), bandIsActive.end(), false);
+    activeOversamplingOrder = 0;
+    isLinearPhaseActive = false;
+    
+    settingsBuffer.pickUpLatest();
+    applySettings(settingsBuffer.getReadBuffer());
+    engine.jumpToTargets();
+}
+
+void EqualiserAudioProcessor::handleAsyncUpdate()
+{
+    const ScopedLock lock(publishLock);
+    publishSettings();
+}
+
+void EqualiserAudioProcessor::parameterValueChanged (int /* parameterIndex */, float /* newValue */)
+{
+    triggerAsyncUpdate();
+}
+
+void EqualiserAudioProcessor::publishSettings()
+{
+    EqSettings& settings = settingsBuffer.getWriteBuffer();
+    
+    // Before prepareToPlay there are no oversamplers or convolution yet, so start with the plain biquads
+    const bool isPrepared = (oversamplers[0] != nullptr);
+    const int oversamplingOrder = isPrepared ? oversamplingParam->getIndex() : 0;
+    const bool linearPhaseMode = isPrepared && phaseParam->getIndex() == 1;
+    
+    for (int i = 0; i < numBands; ++i)
+    {
+        settings.bands[i].design = bands[i]->designCoefficients(designer, 1 << oversamplingOrder);
+        settings.bands[i].enabled = bands[i]->enabledParam->get();
+        settings.bands[i].typeChangeCount = bands[i]->typeChangeCount;
+        
+        // The linear phase kernel is static, so it can't follow the dynamics
+        settings.bands[i].dynamic = ! linearPhaseMode && bands[i]->isDynamic();
+        
+        if (settings.bands[i].dynamic)
+            bands[i]->designDynamics(settings.bands[i].dynamics, 1 << oversamplingOrder);
+    }
+    
+    settings.oversamplingOrder = oversamplingOrder;
+    settings.linearPhase = linearPhaseMode;
+    settingsBuffer.publish();
+    
+    // The partition sizes are 256, 512, 1024 and 2048. A new size is built together with the next kernel.
+    linearPhase.setPartitionSize(256 << partitionSizeParam->getIndex());
+    
+    enabledDesigns.clear();
+    
+    for (const auto& band : settings.bands)
+        if (band.enabled)
+            enabledDesigns.push_back(band.design);
+    
+    enabledDesignSamplerate = samplerate * (1 << oversamplingOrder);
+    ++responseVersion;
+    
+    // The linear phase kernel is made only when it's used
+    if (linearPhaseMode)
+        linearPhase.setDesigns(enabledDesigns, enabledDesignSamplerate);
+    
+    // The up- and downsampling filters and the convolution delay the signal, tell the host so that it can compensate
+    int latency = 0;
+    
+    if (linearPhaseMode)
+        latency = linearPhase.getLatencyInSamples();
+    else if (oversamplingOrder > 0)
+        latency = roundToInt(oversamplers[oversamplingOrder - 1]->getLatencyInSamples());
+    
+    setLatencySamples(latency);
+}
+
+int EqualiserAudioProcessor::getResponseDesigns(std::vector<CoefficientDesigner::FilterDesign>& designs, double& designSamplerate)
+{
+    const ScopedLock lock(publishLock);
+    
+    designs = enabledDesigns;
+    designSamplerate = enabledDesignSamplerate;
+    return responseVersion;
+}
+
+void EqualiserAudioProcessor::applySettings(const EqSettings& settings)
+{
+    activeCascades.clear();
+    activeDynamicBands.clear();
+    
+    // The old filter states are at a different samplerate, or haven't been running, so start all bands again from silence.
+    // The new oversampler or the convolution may have old samples from the last time they were used, clear those too.
+    if (settings.oversamplingOrder != activeOversamplingOrder || settings.linearPhase != isLinearPhaseActive)
+    {
+        std::fill(bandIsActive.begin(), bandIsActive.end(), false);
+        
+        if (settings.oversamplingOrder > 0)
+            oversamplers[settings.oversamplingOrder - 1]->reset();
+        
+        if (settings.linearPhase)
+            linearPhase.reset();
+        
+        activeOversamplingOrder = settings.oversamplingOrder;
+        isLinearPhaseActive = settings.linearPhase;
+    }
+    
+    for (int i = 0; i < numBands; ++i)
+    {
+        const BandSettings& band = settings.bands[i];
+        const BiquadEngine::Cascade cascade { i * CoefficientDesigner::maxNumSections, band.design.numSections };
+        
+        // The engine moves to the new coefficients during the next block
+        for (int k = 0; k < cascade.numSections; ++k)
+            engine.setTargetCoefficients(cascade.firstSection + k, band.design.sections[k]);
+        
+        // A band that was just turned on, or that has a new filter type, starts from silence with its current coefficients.
+        // The old state and coefficients don't make sense for a different filter, or for a band that has been off for a while.
+        const bool isTurnedOn = band.enabled && ! bandIsActive[i];
+        const bool typeChanged = band.typeChangeCount != bandTypeChangeCounts[i];
+        
+        if (isTurnedOn || typeChanged)
+        {
+            for (int k = 0; k < cascade.numSections; ++k)
+            {
+                engine.jumpToTarget(cascade.firstSection + k);
+                engine.clearState(cascade.firstSection + k);
+            }
+            
+            dynamicBands[i].reset();
+        }
+        
+        bandTypeChangeCounts[i] = band.typeChangeCount;
+        bandIsActive[i] = band.enabled;
+        
+        if (band.enabled)
+            activeCascades.push_back(cascade);
+        
+        if (band.enabled && band.dynamic)
+            activeDynamicBands.push_back(i);
+    }
+}
+
+void EqualiserAudioProcessor::processBands(float* const* channels, int numChannels, int numSamples)
+{
+    // Without dynamic bands, the coefficients change only once per block
+    if (activeDynamicBands.empty())
+    {
+        engine.process(channels, numChannels, numSamples, activeCascades.data(), (int) activeCascades.size());
+        return;
+    }
+    
+    // With dynamic bands, process in short intervals, and update the gains of the dynamic bands before each of them.
+    // The interval is the same length of time when oversampling.
+    const EqSettings& settings = settingsBuffer.getReadBuffer();
+    const int interval = DynamicBand::controlInterval << activeOversamplingOrder;
+    
+    for (int start = 0; start < numSamples; start += interval)
+    {
+        const int length = jmin(interval, numSamples - start);
+        
+        for (int ch = 0; ch < numChannels; ++ch)
+            intervalChannels[ch] = channels[ch] + start;
+        
+        // The detectors listen to the input of the EQ, before the bands have changed it.
+        // A dynamic peaking band has a single section.
+        for (const int i : activeDynamicBands)
+        {
+            const auto coefficients = dynamicBands[i].process(settings.bands[i].dynamics, intervalChannels.data(), numChannels, length);
+            engine.setTargetCoefficients(i * CoefficientDesigner::maxNumSections, coefficients);
+        }
+        
+        engine.process(intervalChannels.data(), numChannels, length, activeCascades.data(), (int) activeCascades.size());
+    }
 }
 
 void EqualiserAudioProcessor::releaseResources()
@@ -106,28 +345,47 @@ void EqualiserAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, ju
     
     const int numChannels = buffer.getNumChannels();
     const int numSamples = buffer.getNumSamples();
-
-    for (int ch = 0; ch < numChannels; ++ch)
+    
+    // If the message thread has published new settings, take them into use.
+    // The settings are a complete set, so we never get coefficients of a half-updated band.
+    if (settingsBuffer.pickUpLatest())
+        applySettings(settingsBuffer.getReadBuffer());
+    
+    preEqFifo.push(buffer);
+    
+    if (isLinearPhaseActive)
     {
-        auto* channelData = buffer.getWritePointer (ch);
+        // The linear phase mode replaces the biquads completely
+        linearPhase.process(buffer);
+    }
+    else if (activeOversamplingOrder == 0)
+    {
+        // Filter all channels through the active bands, all bands run in series
+        processBands(buffer.getArrayOfWritePointers(), numChannels, numSamples);
+    }
+    else
+    {
+        // Upsample, filter at the higher samplerate, and downsample back to the buffer.
+        // samplesPerBlock is only a hint and the oversampler has room for that many samples only,
+        // so a longer block from the host goes through it in pieces, like the engine does with its own blocks.
+        auto& oversampler = *oversamplers[activeOversamplingOrder - 1];
+        dsp::AudioBlock<float> block (buffer);
         
-        for (int i=0; i<numSamples; ++i)
+        for (int start = 0; start < numSamples; start += oversamplerBlockSize)
         {
-            // for easier reading, copy the sample from io buffer
-            // this should be optimised by the compiler
-            auto sample = channelData[i];
+            dsp::AudioBlock<float> piece = block.getSubBlock((size_t) start, (size_t) jmin(oversamplerBlockSize, numSamples - start));
+            dsp::AudioBlock<float> oversampledBlock = oversampler.processSamplesUp(piece);
             
-            // Replace sample with all bands, all bands run in series
-            // There's an array of Biquad objects inside each band, with the name biquad.
-            // A specific Biquad object per channel is then accessed with the [ch], and performFilter is called
-            // It takes a sample as an input, and returns a sample, that we replace our "sample" with.
-            sample = band0.biquads[ch].performFilter(sample);
-            sample = band1.biquads[ch].performFilter(sample);
+            for (int ch = 0; ch < numChannels; ++ch)
+                oversampledChannels[ch] = oversampledBlock.getChannelPointer(ch);
             
-            // write back to io buffer
-            channelData[i] = sample;
+            processBands(oversampledChannels.data(), numChannels, (int) oversampledBlock.getNumSamples());
+            
+            oversampler.processSamplesDown(piece);
         }
     }
+    
+    postEqFifo.push(buffer);
 }
 
 //==============================================================================
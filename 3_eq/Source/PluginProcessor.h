@@ -2,12 +2,21 @@
 
 #include <JuceHeader.h>
 #include "FilterBand.h"
+#include "BiquadEngine.h"
+#include "TripleBuffer.h"
+#include "LinearPhaseEqualiser.h"
+#include "AudioFifo.h"
 
-class EqualiserAudioProcessor  : public juce::AudioProcessor
+// The processor is also an AsyncUpdater: the bands trigger it when their parameters change,
+// and handleAsyncUpdate designs the new coefficients on the message thread.
+// It listens to its own oversampling, phase and partition size parameters the same way.
+class EqualiserAudioProcessor  : public juce::AudioProcessor,
+                                 private juce::AsyncUpdater,
+                                 private juce::AudioProcessorParameter::Listener
 {
 public:
     //==============================================================================
-    EqualiserAudioProcessor();
+    explicit EqualiserAudioProcessor(int numBandsToUse = minNumBands);
     ~EqualiserAudioProcessor() override;
 
     //==============================================================================
@@ -43,12 +52,130 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
     
-    FilterBand band0;
-    FilterBand band1;
+    // Number of bands, fixed when the processor is created. Everything that has a value per band is sized for it in the constructor.
+    static constexpr int minNumBands = 8;
+    static constexpr int maxNumBands = 24;
+    const int numBands;
+    
+    // The bands, in the order that they run in. OwnedArray deletes the bands when the processor is deleted.
+    OwnedArray<FilterBand> bands;
+    
+    // For checking how well the coefficient cache works, the editor shows getCoefficientDesigner().getHitRate().
+    // Call on the message thread only.
+    const CoefficientDesigner& getCoefficientDesigner() const { return designer; }
+    
+    // The bilinear transform squeezes the whole frequency axis below Nyquist, so close to Nyquist the filters get
+    // narrower and steeper than they should. E.g. a wide peak at 15 kHz at 44.1 kHz is clearly lopsided.
+    // Running the filters at 2x or 4x the samplerate moves Nyquist far away from the audible range, which fixes this.
+    // The choices are "Off", "2x" and "4x", i.e. the index is the oversampling order: the factor is 2 ^ index.
+    AudioParameterChoice* oversamplingParam;
+    
+    // The highest oversampling order, 4x
+    static constexpr int maxOversamplingOrder = 2;
+    
+    // "Minimum" runs the bands as biquads, "Linear" convolves the audio with the magnitude response of the bands,
+    // see LinearPhaseEqualiser. In the linear phase mode the oversampling doesn't process anything, but the bands are
+    // still designed at the oversampled rate, so their magnitudes don't cramp close to Nyquist.
+    AudioParameterChoice* phaseParam;
+    
+    // The partition size of the linear phase convolution, i.e. its latency. Smaller partitions need more CPU.
+    // Building the convolution allocates memory, so it's built on the background thread of LinearPhaseEqualiser,
+    // together with the kernel, and the new latency is reported to the host right away.
+    AudioParameterChoice* partitionSizeParam;
+    
+    // The audio before and after the EQ, for the spectrum analyser in the editor
+    static constexpr int analyserFifoSize = 1 << 14;
+    AudioFifo preEqFifo { analyserFifoSize };
+    AudioFifo postEqFifo { analyserFifoSize };
+    
+    // For drawing the frequency response of the EQ. The version changes whenever the bands do, so the editor can check it
+    // cheaply, and only copy the designs of the enabled bands when they have changed. Call on the message thread only.
+    int getResponseVersion() const { return responseVersion; }
+    int getResponseDesigns(std::vector<CoefficientDesigner::FilterDesign>& designs, double& designSamplerate);
     
 private:
     
-    double samplerate;
+    // Everything that the audio thread needs to know about a band
+    struct BandSettings
+    {
+        CoefficientDesigner::FilterDesign design;
+        bool enabled = false;
+        int typeChangeCount = 0;
+        
+        // Only filled in for dynamic bands
+        bool dynamic = false;
+        DynamicBand::Settings dynamics;
+    };
+    
+    struct EqSettings
+    {
+        std::vector<BandSettings> bands;   // numBands of them, sized in the constructor so that publishing never allocates
+        int oversamplingOrder = 0;  // the coefficients are designed for this oversampling
+        bool linearPhase = false;
+    };
+    
+    // Design the coefficients of all bands and publish them to the audio thread
+    void handleAsyncUpdate() override;
+    void publishSettings();
+    
+    // Called when the oversampling, the phase or the partition size changes, same as with the bands
+    void parameterValueChanged (int parameterIndex, float newValue) override;
+    void parameterGestureChanged (int parameterIndex, bool gestureIsStarting) override {}
+    
+    // Take the published settings into use on the audio thread, at the start of a block
+    void applySettings(const EqSettings& settings);
+    
+    // Run the biquad bands over the channels, at the normal or the oversampled rate
+    void processBands(float* const* channels, int numChannels, int numSamples);
+    
+    // Designs the coefficients for the bands, and caches them. Used on the message thread only.
+    CoefficientDesigner designer;
+    
+    // Filters all channels through all bands. Each band has room for the longest filter in the engine,
+    // its sections start at band * CoefficientDesigner::maxNumSections.
+    BiquadEngine engine;
+    
+    // The settings go from the message thread to the audio thread through this, without locks
+    TripleBuffer<EqSettings> settingsBuffer;
+    
+    // Only one thread can write to the triple buffer at a time. The message thread and prepareToPlay use this lock to
+    // take turns. The audio thread never touches it.
+    CriticalSection publishLock;
+    
+    // The sections of the bands that are turned on, this is what the engine processes.
+    // Rebuilt only when new settings arrive, not on every block.
+    std::vector<BiquadEngine::Cascade> activeCascades;
+    std::vector<bool> bandIsActive;
+    std::vector<int> bandTypeChangeCounts;
+    
+    // The detectors of the dynamic bands, one for each band, and the bands that are dynamic right now
+    std::vector<DynamicBand> dynamicBands;
+    std::vector<int> activeDynamicBands;
+    
+    // The channel pointers of one control interval, for the engine
+    std::vector<float*> intervalChannels;
+    
+    // One oversampler for each order, 2x and 4x. Both are allocated in prepareToPlay so that switching between them
+    // never allocates on the audio thread, but only the one in use costs any CPU.
+    std::unique_ptr<dsp::Oversampling<float>> oversamplers[maxOversamplingOrder];
+    int activeOversamplingOrder = 0;
+    
+    // The longest block that the oversamplers were initialised for
+    int oversamplerBlockSize = 512;
+    
+    // The channel pointers of the oversampled block, for the engine
+    std::vector<float*> oversampledChannels;
+    
+    LinearPhaseEqualiser linearPhase;
+    bool isLinearPhaseActive = false;
+    
+    // The designs of the bands that are turned on, for the linear phase mode and the editor. Collected on the message thread.
+    std::vector<CoefficientDesigner::FilterDesign> enabledDesigns;
+    double enabledDesignSamplerate = 44100;
+    std::atomic<int> responseVersion { 0 };
+    
+    // The bands design with this before prepareToPlay too, e.g. when the host sets a parameter right after creating the plug-in
+    double samplerate = 44100.0;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EqualiserAudioProcessor)
 };
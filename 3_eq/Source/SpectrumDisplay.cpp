@@ -0,0 +1,201 @@
+#include "SpectrumDisplay.h"
+
+SpectrumDisplay::Analyser::Analyser(AudioFifo& fifoToRead)
+: fifo(fifoToRead)
+, history(fftSize, 0.0f)
+, levels(fftSize / 2, minDecibels)
+{
+}
+
+SpectrumDisplay::SpectrumDisplay(EqualiserAudioProcessor& p)
+: audioProcessor(p)
+, fft(fftOrder)
+, window(fftSize, dsp::WindowingFunction<float>::hann)
+, fftData(2 * fftSize, 0.0f)
+, pullBuffer(fftSize, 0.0f)
+, preAnalyser(p.preEqFifo)
+, postAnalyser(p.postEqFifo)
+{
+    startTimerHz(30);
+}
+
+SpectrumDisplay::~SpectrumDisplay()
+{
+    stopTimer();
+}
+
+void SpectrumDisplay::timerCallback()
+{
+    bool hasChanged = false;
+
+    for (auto* analyser : { &preAnalyser, &postAnalyser })
+    {
+        if (pullAudio(*analyser) && updateLevels(*analyser))
+        {
+            updateSpectrumPath(*analyser);
+            hasChanged = true;
+        }
+    }
+
+    // Evaluating the response means sin and cos for each pixel and band, so do it only when the bands have changed
+    if (audioProcessor.getResponseVersion() != responseVersion)
+    {
+        responseVersion = audioProcessor.getResponseDesigns(designs, designSamplerate);
+        updateResponsePath();
+        hasChanged = true;
+    }
+
+    if (hasChanged)
+        repaint();
+}
+
+bool SpectrumDisplay::pullAudio(Analyser& analyser)
+{
+    bool hasNewAudio = false;
+
+    // Read everything there is, but keep only the latest fftSize samples
+    while (const int numRead = analyser.fifo.pull(pullBuffer.data(), fftSize))
+    {
+        for (int i = 0; i < numRead; ++i)
+        {
+            analyser.history[analyser.historyIndex] = pullBuffer[i];
+            analyser.historyIndex = (analyser.historyIndex + 1) % fftSize;
+        }
+
+        hasNewAudio = true;
+    }
+
+    return hasNewAudio;
+}
+
+bool SpectrumDisplay::updateLevels(Analyser& analyser)
+{
+    // Unwrap the circular buffer, the oldest sample first
+    for (int i = 0; i < fftSize; ++i)
+        fftData[i] = analyser.history[(analyser.historyIndex + i) % fftSize];
+
+    window.multiplyWithWindowingTable(fftData.data(), fftSize);
+    fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+    // A full scale sine gives a magnitude of fftSize / 2, and the Hann window halves that
+    const float scale = 4.0f / fftSize;
+
+    // The levels jump up right away, but fall at most this much per frame, so the picture doesn't flicker
+    const float fallPerFrame = 1.5f;
+
+    bool hasChanged = false;
+
+    for (int bin = 0; bin < fftSize / 2; ++bin)
+    {
+        const float level = Decibels::gainToDecibels(fftData[bin] * scale, minDecibels);
+        const float newLevel = jmax(level, analyser.levels[bin] - fallPerFrame, minDecibels);
+
+        hasChanged = hasChanged || (newLevel != analyser.levels[bin]);
+        analyser.levels[bin] = newLevel;
+    }
+
+    return hasChanged;
+}
+
+void SpectrumDisplay::updateSpectrumPath(Analyser& analyser)
+{
+    analyser.path.clear();
+
+    const int width = getWidth();
+    const float height = (float) getHeight();
+    const double samplerate = audioProcessor.getSampleRate();
+
+    if (width <= 0 || samplerate <= 0)
+        return;
+
+    const float binsPerHertz = (float) (fftSize / samplerate);
+
+    for (int x = 0; x < width; ++x)
+    {
+        // At high frequencies one pixel covers many bins, show the loudest of them
+        const int firstBin = jlimit(0, fftSize / 2 - 1, (int) (getFrequencyForX((float) x) * binsPerHertz));
+        const int lastBin = jlimit(firstBin, fftSize / 2 - 1, (int) (getFrequencyForX((float) x + 1) * binsPerHertz));
+
+        float level = minDecibels;
+
+        for (int bin = firstBin; bin <= lastBin; ++bin)
+            level = jmax(level, analyser.levels[bin]);
+
+        const float y = jmap(level, minDecibels, 0.0f, height, 0.0f);
+
+        if (x == 0)
+            analyser.path.startNewSubPath(0.0f, y);
+        else
+            analyser.path.lineTo((float) x, y);
+    }
+}
+
+void SpectrumDisplay::updateResponsePath()
+{
+    responsePath.clear();
+
+    const int width = getWidth();
+    const float height = (float) getHeight();
+
+    if (width <= 0)
+        return;
+
+    for (int x = 0; x < width; ++x)
+    {
+        const double frequency = getFrequencyForX((float) x);
+
+        // The bands are in series, so their magnitudes multiply
+        double magnitude = 1.0;
+
+        for (const auto& design : designs)
+            for (int k = 0; k < design.numSections; ++k)
+                magnitude *= Biquad<double>::get_magnitude(design.sections[k], frequency, designSamplerate);
+
+        const float decibels = jlimit(-maxResponseDecibels, maxResponseDecibels, (float) Decibels::gainToDecibels(magnitude, -100.0));
+        const float y = jmap(decibels, -maxResponseDecibels, maxResponseDecibels, height, 0.0f);
+
+        if (x == 0)
+            responsePath.startNewSubPath(0.0f, y);
+        else
+            responsePath.lineTo((float) x, y);
+    }
+}
+
+float SpectrumDisplay::getFrequencyForX(float x) const
+{
+    // Logarithmic: every decade takes the same width
+    return minFrequency * std::pow(maxFrequency / minFrequency, x / jmax(1, getWidth()));
+}
+
+void SpectrumDisplay::paint(Graphics& g)
+{
+    g.fillAll(Colours::black);
+
+    // Lines at 100 Hz, 1 kHz and 10 kHz, and at 0 dB of the response
+    g.setColour(Colours::darkgrey);
+
+    for (const float frequency : { 100.0f, 1000.0f, 10000.0f })
+    {
+        const float x = getWidth() * std::log(frequency / minFrequency) / std::log(maxFrequency / minFrequency);
+        g.drawVerticalLine(roundToInt(x), 0.0f, (float) getHeight());
+    }
+
+    g.drawHorizontalLine(getHeight() / 2, 0.0f, (float) getWidth());
+
+    g.setColour(Colours::grey);
+    g.strokePath(preAnalyser.path, PathStrokeType(1.0f));
+
+    g.setColour(Colours::lightblue);
+    g.strokePath(postAnalyser.path, PathStrokeType(1.0f));
+
+    g.setColour(Colours::white);
+    g.strokePath(responsePath, PathStrokeType(2.0f));
+}
+
+void SpectrumDisplay::resized()
+{
+    // The paths depend on the size
+    updateSpectrumPath(preAnalyser);
+    updateSpectrumPath(postAnalyser);
+    updateResponsePath();
+}
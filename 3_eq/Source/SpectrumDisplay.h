@@ -0,0 +1,78 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+// Draws the spectrum of the audio before and after the EQ, and the frequency response of the bands on top of them.
+//
+// The audio comes from the processor's fifos. A timer reads them about 30 times per second, which is plenty for the eye,
+// and runs an FFT of the latest samples. The frequency axis is logarithmic, like in most EQs.
+//
+// Drawing is the expensive part of a UI, so the paths are built only when something has changed, and the component is
+// repainted only then. The response curve changes only when the bands do, so it isn't even evaluated otherwise.
+// When the audio is stopped, the spectrum falls to the floor, and after that there's nothing to repaint.
+class SpectrumDisplay : public Component,
+                        private Timer
+{
+public:
+    SpectrumDisplay(EqualiserAudioProcessor& processor);
+    ~SpectrumDisplay() override;
+
+    void paint (Graphics& g) override;
+    void resized() override;
+
+private:
+
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize = 1 << fftOrder;
+
+    // The range of the display: the spectrum from minDecibels to 0 dB, and the response from -maxResponseDecibels to +maxResponseDecibels
+    static constexpr float minDecibels = -90.0f;
+    static constexpr float maxResponseDecibels = 24.0f;
+    static constexpr float minFrequency = 20.0f;
+    static constexpr float maxFrequency = 20000.0f;
+
+    // The spectrum of one of the fifos
+    struct Analyser
+    {
+        Analyser(AudioFifo& fifoToRead);
+
+        AudioFifo& fifo;
+        std::vector<float> history;     // the latest fftSize samples, as a circular buffer
+        int historyIndex = 0;           // the oldest sample
+        std::vector<float> levels;      // the level of each bin in decibels, falls slowly for a smoother picture
+        Path path;
+    };
+
+    void timerCallback() override;
+
+    // Read the new samples of the analyser. Returns false if there weren't any.
+    bool pullAudio(Analyser& analyser);
+
+    // Run the FFT of the analyser. Returns false if the levels didn't change, e.g. when the input is silent.
+    bool updateLevels(Analyser& analyser);
+
+    // Build the paths for the current size of the component
+    void updateSpectrumPath(Analyser& analyser);
+    void updateResponsePath();
+
+    float getFrequencyForX(float x) const;
+
+    EqualiserAudioProcessor& audioProcessor;
+
+    dsp::FFT fft;
+    dsp::WindowingFunction<float> window;
+    std::vector<float> fftData;     // twice the FFT size, the frequency only transform needs the room
+    std::vector<float> pullBuffer;
+
+    Analyser preAnalyser;
+    Analyser postAnalyser;
+
+    // The designs of the enabled bands, copied from the processor when they change
+    std::vector<CoefficientDesigner::FilterDesign> designs;
+    double designSamplerate = 44100;
+    int responseVersion = -1;
+    Path responsePath;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectrumDisplay)
+};
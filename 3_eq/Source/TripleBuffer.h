@@ -0,0 +1,58 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Passes data from one thread to another without locks, e.g. filter coefficients from the message thread to the audio thread.
+//
+// There are three copies of the data. The writer fills one, the reader reads another, and the third one is in the middle,
+// holding the latest data that the writer has finished. When the writer is done, it swaps its copy with the one in the
+// middle. When the reader wants the latest data, it swaps its copy with the one in the middle. The swaps are single
+// atomic operations, so neither thread ever waits for the other, and the reader never sees a half-written copy.
+//
+// There can be only one writer thread and one reader thread at a time.
+template <typename DataType>
+class TripleBuffer
+{
+public:
+
+    // Set all three copies, e.g. to allocate the memory of each one before the threads start using them
+    void fill(const DataType& data)
+    {
+        for (auto& buffer : buffers)
+            buffer = data;
+    }
+
+    // The writer fills this, and then calls publish
+    DataType& getWriteBuffer() { return buffers[writeIndex]; }
+
+    // Make the written data the latest, and get another copy to write to
+    void publish()
+    {
+        writeIndex = middle.exchange(writeIndex | newDataFlag) & indexMask;
+    }
+
+    // The reader calls this to take the latest data into use. Returns false if nothing new has been published.
+    bool pickUpLatest()
+    {
+        if ((middle.load() & newDataFlag) == 0)
+            return false;
+
+        readIndex = middle.exchange(readIndex) & indexMask;
+        return true;
+    }
+
+    // The data that the reader picked up last
+    const DataType& getReadBuffer() const { return buffers[readIndex]; }
+
+private:
+
+    // The index in the middle also tells if it's newer than what the reader has
+    static constexpr int indexMask = 3;
+    static constexpr int newDataFlag = 4;
+
+    DataType buffers[3];
+
+    int writeIndex = 0;
+    int readIndex = 1;
+    std::atomic<int> middle { 2 };
+};
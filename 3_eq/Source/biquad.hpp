@@ -1,3 +1,5 @@
+#pragma once
+
 // This file demonstrates how to implement a biquad-based equaliser.
 // A biquad is a typical way of implementing recursive IIR filter equations.
 // For simple use, an explanation and design formulas written by Robert Bristow-Johnson are often used.
@@ -23,79 +25,330 @@
 template <typename FloatType>
 struct Biquad
 {
-    // Generally a pretty inefficients way to do the iir one sample at a time, but with modern CPU's
-    // there's little reason to optimise this further - compiler is likely to do that anyway.
-    // If the utmost performance is needed, we could resort to a more complex and specific implementation anyway.
-    FloatType performFilter(FloatType inputSample)
+    // The coefficients of a biquad, normalised so that a0 = 1.
+    // G is the gain of the input sample (b0), ff1 and ff2 are the feedforward coefficients (b1, b2),
+    // and fb1 and fb2 are the feedback coefficients (a1, a2).
+    struct Coefficients
     {
-        FloatType v0 = inputSample - fb1 * v1 - fb2 * v2;
-        FloatType y0 = G * v0 + ff1 * v1 + ff2 * v2;
+        FloatType G = 1, ff1 = 0, ff2 = 0, fb1 = 0, fb2 = 0;
+        
+        bool operator== (const Coefficients& other) const
+        {
+            return G == other.G && ff1 == other.ff1 && ff2 == other.ff2 && fb1 == other.fb1 && fb2 == other.fb2;
+        }
         
-        v2 = v1;
-        v1 = v0;
+        bool operator!= (const Coefficients& other) const { return ! (*this == other); }
+    };
+    
+    // The filter is in the so-called Transposed Direct Form II (TDF-II).
+    // It needs only two state variables, s1 and s2, and behaves better than Direct Form II with floating point numbers,
+    // especially when the coefficients change while the filter is running.
+    //
+    // This processes a single sample, which is handy for testing. For real processing, use processBlock.
+    FloatType performFilter(FloatType inputSample)
+    {
+        const FloatType y0 = coeffs.G * inputSample + s1;
+        s1 = coeffs.ff1 * inputSample - coeffs.fb1 * y0 + s2;
+        s2 = coeffs.ff2 * inputSample - coeffs.fb2 * y0;
         
         return y0;
     }
     
+    // Process a block of samples in place.
+    //
+    // The coefficients and the state are copied to local variables for the duration of the loop. This tells the compiler
+    // that nothing else can change them during the loop, so it can keep them in registers instead of reading them from memory
+    // and writing them back on every sample.
+    //
+    // If new coefficients have been designed since the last block, the coefficients move linearly from the old ones
+    // to the new ones during the block. Jumping straight to the new coefficients would cause a click or zipper noise
+    // when the parameters are automated.
+    template <typename SampleType>
+    void processBlock(SampleType* data, int numSamples)
+    {
+        if (numSamples <= 0)
+            return;
+        
+        FloatType state1 = s1;
+        FloatType state2 = s2;
+        
+        FloatType G = coeffs.G, ff1 = coeffs.ff1, ff2 = coeffs.ff2, fb1 = coeffs.fb1, fb2 = coeffs.fb2;
+        
+        if (coeffs == target)
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const FloatType x = data[i];
+                const FloatType y = G * x + state1;
+                state1 = ff1 * x - fb1 * y + state2;
+                state2 = ff2 * x - fb2 * y;
+                data[i] = (SampleType) y;
+            }
+        }
+        else
+        {
+            // How much each coefficient changes per sample, so that the last sample of the block uses the target coefficients
+            const FloatType step = (FloatType) 1 / numSamples;
+            const FloatType dG   = (target.G   - G)   * step;
+            const FloatType dff1 = (target.ff1 - ff1) * step;
+            const FloatType dff2 = (target.ff2 - ff2) * step;
+            const FloatType dfb1 = (target.fb1 - fb1) * step;
+            const FloatType dfb2 = (target.fb2 - fb2) * step;
+            
+            for (int i = 0; i < numSamples; ++i)
+            {
+                G += dG; ff1 += dff1; ff2 += dff2; fb1 += dfb1; fb2 += dfb2;
+                
+                const FloatType x = data[i];
+                const FloatType y = G * x + state1;
+                state1 = ff1 * x - fb1 * y + state2;
+                state2 = ff2 * x - fb2 * y;
+                data[i] = (SampleType) y;
+            }
+            
+            // Avoid rounding errors piling up, and let the next block take the fast path
+            coeffs = target;
+        }
+        
+        s1 = state1;
+        s2 = state2;
+    }
+    
+    // Use the target coefficients right away, without moving towards them during the next block.
+    // Useful when starting the playback, when there are no old coefficients to move from.
+    void jumpToTarget()
+    {
+        coeffs = target;
+    }
+    
     void clearState()
     {
-        v2 = 0.0;
-        v1 = 0.0;
+        s1 = 0.0;
+        s2 = 0.0;
     }
 
-    FloatType G, fb1, fb2, ff1, ff2; // coeffs
-    FloatType v1, v2;  // internal state
+    Coefficients coeffs;    // the coefficients that the filter is using
+    Coefficients target;    // the coefficients that the filter moves to during the next block
+    FloatType s1 = 0, s2 = 0;  // internal state
+
+    // Set the coefficients that the filter moves to during the next block
+    void setTargetCoefficients(const Coefficients& newCoefficients)
+    {
+        target = newCoefficients;
+    }
+
+    // The design functions calculate the coefficients for a filter type, and return them.
+    // They are static, so they don't need a Biquad object: call them as Biquad<double>::design_lowpass_filter(...).
+    // This way the coefficients can be designed once and then given to as many filters as needed.
+    //
+    // Every design needs the sin and cos of w0, the center frequency in radians per sample, and those are the slow part.
+    // So each design comes in two versions: one that takes the frequency and the samplerate, and one that takes an Angle
+    // with sin and cos already calculated, e.g. from a table, or once for several designs at the same frequency.
+    struct Angle
+    {
+        FloatType sinw0 = 0, cosw0 = 1;
+    };
 
-    // Design a lowpass filter and replace biquad's coefficients with them
-    // This is a template function. When you pass in the Biquad-reference bq, the compiler is able to
-    // deduce the type of the FloatType, so you can basically use it just like a normal funtion.
-    void design_lowpass_filter(FloatType f0, FloatType Q, FloatType Fs)
+    static Angle get_angle(FloatType f0, FloatType Fs)
     {
         const FloatType pi = 3.14159265359;
         const FloatType w0 = 2 * pi * f0/Fs;
-        const FloatType alpha = sin(w0)/(2*Q);
+        return { sin(w0), cos(w0) };
+    }
+
+    // Design a lowpass filter
+    static Coefficients design_lowpass_filter(FloatType f0, FloatType Q, FloatType Fs)
+    {
+        return design_lowpass_filter(get_angle(f0, Fs), Q);
+    }
+
+    static Coefficients design_lowpass_filter(const Angle& angle, FloatType Q)
+    {
+        const FloatType alpha = angle.sinw0/(2*Q);
+        const FloatType cosw0 = angle.cosw0;
 
         // IIR is just a bunch of coefficients that are used to calculate the next sample from previous ones
         // Coefs b0 - b2 and a0 - a2 are the mathematical coefficients straight from RBJ's Audio EQ Cookbook.
-        const FloatType b0 =  (1 - cos(w0))/2;
-        const FloatType b1 =   1 - cos(w0);
-        const FloatType b2 =  (1 - cos(w0))/2;
+        const FloatType b0 =  (1 - cosw0)/2;
+        const FloatType b1 =   1 - cosw0;
+        const FloatType b2 =  (1 - cosw0)/2;
         const FloatType a0 =   1 + alpha;
-        const FloatType a1 =  -2*cos(w0);
+        const FloatType a1 =  -2*cosw0;
         const FloatType a2 =   1 - alpha;
     
         // IIR filters are often normalised to get rid of the a0 coefficient. This is a bit lighter for the processor.
         // So when you copy the implementations from the cookbook, just add this block to get the coeffs to the format that the
         // Biquad struct above is expecting them to be in.
-        G   = b0 / a0;
-        ff1 = b1 / a0;
-        ff2 = b2 / a0;
-        fb1 = a1 / a0;
-        fb2 = a2 / a0;
+        Coefficients c;
+        c.G   = b0 / a0;
+        c.ff1 = b1 / a0;
+        c.ff2 = b2 / a0;
+        c.fb1 = a1 / a0;
+        c.fb2 = a2 / a0;
+        return c;
     }
 
     // Another filter type, the most common one in EQs: peaking EQ band.
-    void design_peaking_filter(FloatType f0, FloatType dBgain, FloatType Q, FloatType Fs)
+    static Coefficients design_peaking_filter(FloatType f0, FloatType dBgain, FloatType Q, FloatType Fs)
+    {
+        return design_peaking_filter(get_angle(f0, Fs), dBgain, Q);
+    }
+
+    static Coefficients design_peaking_filter(const Angle& angle, FloatType dBgain, FloatType Q)
     {
         const FloatType A = pow(10, (dBgain/40));
-        const FloatType pi = 3.14159265359;
-        const FloatType w0 = 2 * pi * f0/Fs;
-        const FloatType alpha = sin(w0)/(2*Q);
+        const FloatType alpha = angle.sinw0/(2*Q);
+        const FloatType cosw0 = angle.cosw0;
 
         const FloatType b0 =   1 + alpha*A;
-        const FloatType b1 =  -2*cos(w0);
+        const FloatType b1 =  -2*cosw0;
         const FloatType b2 =   1 - alpha*A;
         const FloatType a0 =   1 + alpha/A;
-        const FloatType a1 =  -2*cos(w0);
+        const FloatType a1 =  -2*cosw0;
         const FloatType a2 =   1 - alpha/A;
     
-        G   = b0 / a0;
-        ff1 = b1 / a0;
-        ff2 = b2 / a0;
-        fb1 = a1 / a0;
-        fb2 = a2 / a0;
+        Coefficients c;
+        c.G   = b0 / a0;
+        c.ff1 = b1 / a0;
+        c.ff2 = b2 / a0;
+        c.fb1 = a1 / a0;
+        c.fb2 = a2 / a0;
+        return c;
+    }
+
+    // The rest of the RBJ cookbook filters. They all normalise the coefficients the same way as above, so that's done
+    // in the helper function normalise at the end.
+
+    // Highpass, the mirror image of the lowpass
+    static Coefficients design_highpass_filter(FloatType f0, FloatType Q, FloatType Fs)
+    {
+        return design_highpass_filter(get_angle(f0, Fs), Q);
+    }
+
+    static Coefficients design_highpass_filter(const Angle& angle, FloatType Q)
+    {
+        const FloatType alpha = angle.sinw0/(2*Q);
+        const FloatType cosw0 = angle.cosw0;
+
+        return normalise( (1 + cosw0)/2,  -(1 + cosw0),  (1 + cosw0)/2,
+                          1 + alpha,      -2*cosw0,       1 - alpha);
+    }
+
+    // Bandpass with a gain of 0 dB at the center frequency
+    static Coefficients design_bandpass_filter(FloatType f0, FloatType Q, FloatType Fs)
+    {
+        return design_bandpass_filter(get_angle(f0, Fs), Q);
+    }
+
+    static Coefficients design_bandpass_filter(const Angle& angle, FloatType Q)
+    {
+        const FloatType alpha = angle.sinw0/(2*Q);
+        const FloatType cosw0 = angle.cosw0;
+
+        return normalise( alpha,      0,          -alpha,
+                          1 + alpha,  -2*cosw0,   1 - alpha);
+    }
+
+    // Notch, removes the center frequency completely
+    static Coefficients design_notch_filter(FloatType f0, FloatType Q, FloatType Fs)
+    {
+        return design_notch_filter(get_angle(f0, Fs), Q);
+    }
+
+    static Coefficients design_notch_filter(const Angle& angle, FloatType Q)
+    {
+        const FloatType alpha = angle.sinw0/(2*Q);
+        const FloatType cosw0 = angle.cosw0;
+
+        return normalise( 1,          -2*cosw0,   1,
+                          1 + alpha,  -2*cosw0,   1 - alpha);
+    }
+
+    // Allpass, changes only the phase: by 180 degrees at the center frequency
+    static Coefficients design_allpass_filter(FloatType f0, FloatType Q, FloatType Fs)
+    {
+        return design_allpass_filter(get_angle(f0, Fs), Q);
+    }
+
+    static Coefficients design_allpass_filter(const Angle& angle, FloatType Q)
+    {
+        const FloatType alpha = angle.sinw0/(2*Q);
+        const FloatType cosw0 = angle.cosw0;
+
+        return normalise( 1 - alpha,  -2*cosw0,   1 + alpha,
+                          1 + alpha,  -2*cosw0,   1 - alpha);
+    }
+
+    // Low shelf, boosts or cuts everything below the frequency by dBgain. Q sets the steepness of the slope.
+    static Coefficients design_lowshelf_filter(FloatType f0, FloatType dBgain, FloatType Q, FloatType Fs)
+    {
+        return design_lowshelf_filter(get_angle(f0, Fs), dBgain, Q);
+    }
+
+    static Coefficients design_lowshelf_filter(const Angle& angle, FloatType dBgain, FloatType Q)
+    {
+        const FloatType A = pow(10, (dBgain/40));
+        const FloatType alpha = angle.sinw0/(2*Q);
+        const FloatType cosw0 = angle.cosw0;
+        const FloatType twoSqrtAalpha = 2 * sqrt(A) * alpha;
+
+        return normalise(     A*( (A+1) - (A-1)*cosw0 + twoSqrtAalpha ),
+                            2*A*( (A-1) - (A+1)*cosw0 ),
+                              A*( (A+1) - (A-1)*cosw0 - twoSqrtAalpha ),
+                                  (A+1) + (A-1)*cosw0 + twoSqrtAalpha,
+                               -2*( (A-1) + (A+1)*cosw0 ),
+                                  (A+1) + (A-1)*cosw0 - twoSqrtAalpha);
     }
 
+    // High shelf, boosts or cuts everything above the frequency by dBgain
+    static Coefficients design_highshelf_filter(FloatType f0, FloatType dBgain, FloatType Q, FloatType Fs)
+    {
+        return design_highshelf_filter(get_angle(f0, Fs), dBgain, Q);
+    }
+
+    static Coefficients design_highshelf_filter(const Angle& angle, FloatType dBgain, FloatType Q)
+    {
+        const FloatType A = pow(10, (dBgain/40));
+        const FloatType alpha = angle.sinw0/(2*Q);
+        const FloatType cosw0 = angle.cosw0;
+        const FloatType twoSqrtAalpha = 2 * sqrt(A) * alpha;
 
+        return normalise(     A*( (A+1) + (A-1)*cosw0 + twoSqrtAalpha ),
+                           -2*A*( (A-1) + (A+1)*cosw0 ),
+                              A*( (A+1) + (A-1)*cosw0 - twoSqrtAalpha ),
+                                  (A+1) - (A-1)*cosw0 + twoSqrtAalpha,
+                                2*( (A-1) - (A+1)*cosw0 ),
+                                  (A+1) - (A-1)*cosw0 - twoSqrtAalpha);
+    }
+
+    // Divide all coefficients by a0, see the lowpass above
+    static Coefficients normalise(FloatType b0, FloatType b1, FloatType b2, FloatType a0, FloatType a1, FloatType a2)
+    {
+        Coefficients c;
+        c.G   = b0 / a0;
+        c.ff1 = b1 / a0;
+        c.ff2 = b2 / a0;
+        c.fb1 = a1 / a0;
+        c.fb2 = a2 / a0;
+        return c;
+    }
+
+    // The magnitude response of a biquad at the frequency f, i.e. how much a sine of that frequency is amplified.
+    // It's the absolute value of H(z) = (G + ff1 z^-1 + ff2 z^-2) / (1 + fb1 z^-1 + fb2 z^-2), at z = e^jw.
+    // The real and imaginary parts of the numerator and denominator are written out, so no complex numbers are needed.
+    static FloatType get_magnitude(const Coefficients& c, FloatType f, FloatType Fs)
+    {
+        const FloatType pi = 3.14159265359;
+        const FloatType w = 2 * pi * f/Fs;
+        const FloatType cosw = cos(w), sinw = sin(w);
+        const FloatType cos2w = cos(2*w), sin2w = sin(2*w);
+
+        const FloatType numRe = c.G + c.ff1*cosw + c.ff2*cos2w;
+        const FloatType numIm =     - c.ff1*sinw - c.ff2*sin2w;
+        const FloatType denRe = 1   + c.fb1*cosw + c.fb2*cos2w;
+        const FloatType denIm =     - c.fb1*sinw - c.fb2*sin2w;
+
+        return sqrt((numRe*numRe + numIm*numIm) / (denRe*denRe + denIm*denIm));
+    }
 };
 
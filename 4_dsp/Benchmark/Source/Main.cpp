@@ -0,0 +1,145 @@
+// A small command line program that measures the tanh approximations of the Saturator: how far they are from std::tanh,
+// and how long the Saturator takes per sample with each of them.
+//
+// Build the Release configuration, the numbers of a Debug build say nothing about the real cost.
+// The program returns 1 if an approximation is further from std::tanh than Saturator.h says.
+
+#include <JuceHeader.h>
+#include "../../Source/Saturator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+namespace
+{
+    using FloatSaturator = Saturator<float>;
+
+    const int blockSize = 512;
+    const int numBlocks = 20000;
+    const int numTimingRuns = 5;            // the fastest run is reported, the others are disturbed by something else
+
+    // The errors that Saturator.h promises
+    const float fastTolerance = 0.024f;
+    const float accurateTolerance = 0.0001f;
+
+    // The time stamp counter counts the reference cycles of the CPU. It doesn't follow turbo boost, but it's the
+    // closest thing to a cycle count that we get without special permissions.
+    uint64_t readCycleCounter()
+    {
+       #if JUCE_INTEL
+        return (uint64_t) __rdtsc();
+       #else
+        return 0;
+       #endif
+    }
+
+    // The largest difference from std::tanh, over a fine grid from -10 to 10. That goes well past the clamping limits,
+    // so the flat parts are checked too.
+    template <typename Tanh>
+    float getMaxError()
+    {
+        const int numPoints = 2000001;
+        float maxError = 0;
+
+        for (int i = 0; i < numPoints; ++i)
+        {
+            const float x = -10.0f + 20.0f * (float) i / (float) (numPoints - 1);
+            maxError = jmax(maxError, std::abs(Tanh::apply(x) - std::tanh(x)));
+        }
+
+        return maxError;
+    }
+
+    struct Timing
+    {
+        double nanosecondsPerSample = 1e9;
+        double cyclesPerSample = 1e9;
+    };
+
+    // A stereo block of noise through the Saturator with a drive of 4, i.e. up to 12 dB into the curve.
+    // The input is copied back before each block, outside of the timed part, so that every block saturates the same way.
+    Timing time(FloatSaturator::Approximation approximation)
+    {
+        Timing timing;
+
+        AudioBuffer<float> input(2, blockSize), buffer(2, blockSize);
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+        for (int ch = 0; ch < 2; ++ch)
+            for (int i = 0; i < blockSize; ++i)
+                input.setSample(ch, i, distribution(generator));
+
+        FloatSaturator saturator;
+        saturator.setApproximation(approximation);
+        saturator.setDrive(4.0f);
+        saturator.prepare({ 48000.0, (uint32) blockSize, 2 });
+        saturator.reset();
+
+        dsp::AudioBlock<float> block(buffer);
+        dsp::ProcessContextReplacing<float> context(block);
+
+        for (int run = 0; run < numTimingRuns; ++run)
+        {
+            std::chrono::nanoseconds elapsed(0);
+            uint64_t cycles = 0;
+
+            for (int i = 0; i < numBlocks; ++i)
+            {
+                for (int ch = 0; ch < 2; ++ch)
+                    buffer.copyFrom(ch, 0, input, ch, 0, blockSize);
+
+                const auto startTime = std::chrono::high_resolution_clock::now();
+                const uint64_t startCycles = readCycleCounter();
+
+                saturator.process(context);
+
+                cycles += readCycleCounter() - startCycles;
+                elapsed += std::chrono::high_resolution_clock::now() - startTime;
+            }
+
+            const double numSamples = (double) numBlocks * blockSize * 2;
+            timing.nanosecondsPerSample = jmin(timing.nanosecondsPerSample, (double) elapsed.count() / numSamples);
+            timing.cyclesPerSample = jmin(timing.cyclesPerSample, (double) cycles / numSamples);
+        }
+
+        return timing;
+    }
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+    const float fastError = getMaxError<FloatSaturator::FastTanh>();
+    const float accurateError = getMaxError<FloatSaturator::AccurateTanh>();
+
+    const Timing timings[] = { time(FloatSaturator::Approximation::exact),
+                               time(FloatSaturator::Approximation::fast),
+                               time(FloatSaturator::Approximation::accurate) };
+    const char* names[] = { "exact", "fast", "accurate" };
+
+    std::printf("%-10s %14s %14s\n", "", "ns/sample", "cycles/sample");
+
+    for (int i = 0; i < 3; ++i)
+        std::printf("%-10s %14.3f %14.2f\n", names[i], timings[i].nanosecondsPerSample, timings[i].cyclesPerSample);
+
+    std::printf("\nmax error, fast:     %g (allowed %g)\nmax error, accurate: %g (allowed %g)\n",
+                fastError, fastTolerance, accurateError, accurateTolerance);
+
+    const bool ok = fastError <= fastTolerance && accurateError <= accurateTolerance;
+
+    if (ok)
+        std::printf("OK\n");
+    else
+        std::printf("FAILED: an approximation is further from std::tanh than allowed\n");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// The detector parts that the LookaheadCompressor and the MultibandCompressor share: turning the peaks into levels,
+// the gain computer with its soft knee, the attack and release, and the linear gain ramp between two detector updates.
+//
+// The detector doesn't look at every sample. It takes the peak of each detectorInterval samples, and only then runs the
+// level detection, the gain computer and the attack and release for the whole group at once. The gain is interpolated
+// linearly between the groups, so it still changes smoothly. log10 and pow are needed only once per group, not per sample.
+//
+// The compressors keep their detector state in arrays with one lane per channel or band, so that the gain computer and the
+// attack and release run for 4 or 8 lanes with one SIMD instruction. Both are written without branches, with min and max only:
+//
+//     soft knee:  over = level - threshold, x = clamp(over + knee / 2, 0, knee)
+//                 reduction = (1 / ratio - 1) * (x^2 / (2 knee) + max(over - knee / 2, 0))
+//     smoothing:  d = reduction - smoothed
+//                 smoothed += attack * min(d, 0) + release * max(d, 0)
+//
+// The threshold and the slope, 1 / ratio - 1, are passed in with the levels, since the LookaheadCompressor has one of
+// each and the MultibandCompressor one per band. The knee, attack and release are the same for all lanes.
+template <typename SampleType>
+class CompressorGainComputer
+{
+public:
+
+    using Vector = dsp::SIMDRegister<SampleType>;
+
+    // The detector runs once per this many samples
+    static constexpr int detectorInterval = 16;
+
+    void setKnee(SampleType newKneeDb) { knee = jmax(newKneeDb, (SampleType) 0.01); }
+    void setAttack(SampleType newAttackMs) { attackMs = newAttackMs; updateCoefficients(); }
+    void setRelease(SampleType newReleaseMs) { releaseMs = newReleaseMs; updateCoefficients(); }
+
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        updateCoefficients();
+    }
+
+    // The soft knee and the attack and release for one register of lanes, returns the new smoothed reduction in decibels
+    Vector computeReduction(Vector level, Vector threshold, Vector slope, Vector smoothed) const noexcept
+    {
+        const Vector zero = Vector::expand(0);
+        const Vector halfKnee = Vector::expand(knee / 2);
+
+        const Vector over = level - threshold;
+        const Vector x = Vector::min(Vector::max(over + halfKnee, zero), Vector::expand(knee));
+        const Vector target = slope * (x * x * Vector::expand(1 / (2 * knee)) + Vector::max(over - halfKnee, zero));
+        const Vector difference = target - smoothed;
+
+        // More reduction uses the attack, less reduction the release
+        return smoothed + Vector::expand(attackCoefficient) * Vector::min(difference, zero)
+                        + Vector::expand(releaseCoefficient) * Vector::max(difference, zero);
+    }
+
+    // The peaks of the group that just ended in decibels, and start the next group from silence
+    static void takeLevels(SampleType* peaks, SampleType* levels, int numLanes) noexcept
+    {
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            levels[lane] = Decibels::gainToDecibels(peaks[lane], (SampleType) -120);
+            peaks[lane] = 0;
+        }
+    }
+
+    // Set the gains to ramp to the new reductions during the next group
+    static void setGainSteps(const SampleType* reductions, const SampleType* gains, SampleType* gainSteps, int numLanes) noexcept
+    {
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            const SampleType target = Decibels::decibelsToGain(reductions[lane], (SampleType) -120);
+            gainSteps[lane] = (target - gains[lane]) / detectorInterval;
+        }
+    }
+
+    // The gain ramps linearly towards the value computed at the last detector update
+    static void applyGain(SampleType* data, int numSamples, SampleType& gain, SampleType step) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+            data[i] *= gain + step * (SampleType) (i + 1);
+
+        gain += step * (SampleType) numSamples;
+    }
+
+private:
+
+    void updateCoefficients()
+    {
+        // One-pole coefficients at the detector rate
+        const SampleType detectorRate = (SampleType) sampleRate / detectorInterval;
+        attackCoefficient = 1 - std::exp(-1 / (attackMs * (SampleType) 0.001 * detectorRate));
+        releaseCoefficient = 1 - std::exp(-1 / (releaseMs * (SampleType) 0.001 * detectorRate));
+    }
+
+    SampleType knee = 6;
+    SampleType attackMs = 10, releaseMs = 100;
+    SampleType attackCoefficient = 1, releaseCoefficient = 1;
+    double sampleRate = 44100;
+};
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "CompressorGainComputer.h"
+
+// A compressor with lookahead, a soft knee, an optional external sidechain, and linking of any number of channels.
+// It has the same prepare, process and reset functions as the dsp classes, so it can replace dsp::Compressor in a ProcessorChain.
+//
+// The detector takes the peak of each group of detectorInterval samples, and the gain computer in CompressorGainComputer.h
+// turns it into a gain that ramps linearly during the next group. The detector state of all the channels is kept in arrays,
+// one lane per channel, so that the gain computer runs for 4 or 8 channels with one SIMD instruction.
+//
+// When linked, all channels get the same gain, computed from the loudest channel, so that the stereo image doesn't move.
+//
+// Lookahead delays the audio but not the detector, so the gain comes down before the transient arrives. The delay is
+// reported with getLatencyInSamples. The delay buffers are allocated in prepare for the maximum lookahead, and the input
+// is always written to them, so that changing the lookahead only moves the read position. The audio is crossfaded from
+// the old read position to the new one, so it doesn't jump. While bypassed the input is still written to the delay buffers,
+// so that they don't have old audio in them when the compressor is turned on again.
+template <typename SampleType>
+class LookaheadCompressor
+{
+public:
+
+    static constexpr SampleType maxLookaheadMs = 10;
+
+    void setThreshold(SampleType newThresholdDb) { threshold = newThresholdDb; }
+    void setRatio(SampleType newRatio) { jassert(newRatio >= 1); slope = 1 / newRatio - 1; }
+    void setKnee(SampleType newKneeDb) { gainComputer.setKnee(newKneeDb); }
+    void setAttack(SampleType newAttackMs) { gainComputer.setAttack(newAttackMs); }
+    void setRelease(SampleType newReleaseMs) { gainComputer.setRelease(newReleaseMs); }
+    void setLinked(bool shouldBeLinked) { linked = shouldBeLinked; }
+
+    // Can be called from any thread, the delay changes on the next block. Call after prepare.
+    void setLookahead(SampleType newLookaheadMs)
+    {
+        requestedLookahead = jlimit(0, maxLookaheadSamples, roundToInt(newLookaheadMs * (SampleType) 0.001 * sampleRate));
+    }
+
+    int getLatencyInSamples() const { return requestedLookahead; }
+
+    // The detector listens to these channels instead of the input during the next process call. Call from the audio thread,
+    // right before process. The channels are reused if there are fewer of them than in the input, e.g. a mono sidechain.
+    void setSidechain(const dsp::AudioBlock<const SampleType>& sidechainBlock) { sidechain = sidechainBlock; }
+
+    void prepare(const dsp::ProcessSpec& spec)
+    {
+        sampleRate = spec.sampleRate;
+        numChannels = (int) spec.numChannels;
+        gainComputer.prepare(sampleRate);
+
+        // Every lane array is rounded up to whole registers, and the storage has room to align the first one
+        numLanes = (numChannels + (int) Vector::SIMDNumElements - 1) / (int) Vector::SIMDNumElements * (int) Vector::SIMDNumElements;
+        laneStorage.assign((size_t) (numLanes * 2 + (int) Vector::SIMDNumElements), 0);
+        levels = Vector::getNextSIMDAlignedPtr(laneStorage.data());
+        reductions = levels + numLanes;
+
+        peaks.assign((size_t) numChannels, 0);
+        gains.assign((size_t) numChannels, 1);
+        gainSteps.assign((size_t) numChannels, 0);
+
+        // The whole chunk is written before it's read, so the buffers have room for one chunk on top of the lookahead
+        maxLookaheadSamples = (int) std::ceil(maxLookaheadMs * (SampleType) 0.001 * sampleRate);
+        delayLength = maxLookaheadSamples + detectorInterval;
+        delayBuffers.setSize(numChannels, delayLength);
+
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(peaks.begin(), peaks.end(), (SampleType) 0);
+        std::fill(gains.begin(), gains.end(), (SampleType) 1);
+        std::fill(gainSteps.begin(), gainSteps.end(), (SampleType) 0);
+        std::fill(reductions, reductions + numLanes, (SampleType) 0);
+        samplesUntilUpdate = detectorInterval;
+
+        delayBuffers.clear();
+        writeIndex = 0;
+        lookahead = requestedLookahead;
+        previousLookahead = lookahead;
+        crossfadeSamplesLeft = 0;
+    }
+
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        auto&& inputBlock = context.getInputBlock();
+        auto&& outputBlock = context.getOutputBlock();
+
+        // The processing is done in place, so copy the input to the output first if they're different
+        if (context.usesSeparateInputAndOutputBlocks())
+            outputBlock.copyFrom(inputBlock);
+
+        // The sidechain is only valid for this block, forget it so that a stale one is never used
+        const auto detectorBlock = sidechain;
+        sidechain = {};
+
+        jassert((int) outputBlock.getNumChannels() == numChannels);
+
+        const int numSamples = (int) outputBlock.getNumSamples();
+
+        // Keep the delay line going, and take a new lookahead into use right away, since nothing is read
+        if (context.isBypassed)
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+                writeToDelay(outputBlock.getChannelPointer((size_t) ch), numSamples, delayBuffers.getWritePointer(ch));
+
+            writeIndex = (writeIndex + numSamples) % delayLength;
+            lookahead = requestedLookahead;
+            previousLookahead = lookahead;
+            crossfadeSamplesLeft = 0;
+            return;
+        }
+
+        // A new lookahead starts a crossfade from the old read position, unless one is already running
+        if (lookahead != requestedLookahead && crossfadeSamplesLeft == 0)
+        {
+            previousLookahead = lookahead;
+            lookahead = requestedLookahead;
+            crossfadeSamplesLeft = crossfadeLength;
+        }
+
+        const bool useSidechain = detectorBlock.getNumChannels() > 0;
+
+        // Run until the next detector update at a time
+        for (int start = 0; start < numSamples;)
+        {
+            const int numInChunk = jmin(samplesUntilUpdate, numSamples - start);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                const SampleType* detectorData = useSidechain ? detectorBlock.getChannelPointer((size_t) (ch % (int) detectorBlock.getNumChannels())) + start
+                                                              : outputBlock.getChannelPointer((size_t) ch) + start;
+
+                const auto range = FloatVectorOperations::findMinAndMax(detectorData, numInChunk);
+                peaks[(size_t) ch] = jmax(peaks[(size_t) ch], -range.getStart(), range.getEnd());
+
+                SampleType* data = outputBlock.getChannelPointer((size_t) ch) + start;
+                delay(data, numInChunk, delayBuffers.getWritePointer(ch));
+                GainComputer::applyGain(data, numInChunk, gains[(size_t) ch], gainSteps[(size_t) ch]);
+            }
+
+            writeIndex = (writeIndex + numInChunk) % delayLength;
+            crossfadeSamplesLeft = jmax(0, crossfadeSamplesLeft - numInChunk);
+
+            start += numInChunk;
+            samplesUntilUpdate -= numInChunk;
+
+            if (samplesUntilUpdate == 0)
+            {
+                updateGains();
+                samplesUntilUpdate = detectorInterval;
+            }
+        }
+    }
+
+private:
+
+    using GainComputer = CompressorGainComputer<SampleType>;
+    using Vector = typename GainComputer::Vector;
+
+    static constexpr int detectorInterval = GainComputer::detectorInterval;
+
+    // The length of the crossfade when the lookahead changes, about 5 ms
+    static constexpr int crossfadeLength = 256;
+
+    // Take the peaks of the group that just ended, and set the gains to ramp to the new values during the next group
+    void updateGains()
+    {
+        if (linked)
+        {
+            const SampleType loudest = *std::max_element(peaks.begin(), peaks.end());
+            std::fill(peaks.begin(), peaks.end(), loudest);
+        }
+
+        GainComputer::takeLevels(peaks.data(), levels, numChannels);
+
+        const Vector thresholdVector = Vector::expand(threshold);
+        const Vector slopeVector = Vector::expand(slope);
+
+        // For all channels a register at a time
+        for (int lane = 0; lane < numLanes; lane += (int) Vector::SIMDNumElements)
+            gainComputer.computeReduction(Vector::fromRawArray(levels + lane), thresholdVector, slopeVector,
+                                          Vector::fromRawArray(reductions + lane)).copyToRawArray(reductions + lane);
+
+        GainComputer::setGainSteps(reductions, gains.data(), gainSteps.data(), numChannels);
+    }
+
+    // Delay a chunk of at most detectorInterval samples by the lookahead: write it to the circular buffer, and read back
+    // the samples from lookahead samples earlier. During a crossfade, the samples from the old lookahead are read too,
+    // and faded out while the new ones are faded in.
+    void delay(SampleType* data, int numSamples, SampleType* buffer) const
+    {
+        jassert(numSamples <= detectorInterval);
+
+        writeToDelay(data, numSamples, buffer);
+
+        if (crossfadeSamplesLeft == 0)
+        {
+            if (lookahead > 0)
+                readFromDelay(data, numSamples, buffer, lookahead);
+
+            return;
+        }
+
+        SampleType previous[detectorInterval];
+        readFromDelay(previous, numSamples, buffer, previousLookahead);
+        readFromDelay(data, numSamples, buffer, lookahead);
+
+        const SampleType fadeStep = (SampleType) 1 / crossfadeLength;
+        const SampleType firstFade = (SampleType) (crossfadeLength - crossfadeSamplesLeft + 1) * fadeStep;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const SampleType fade = jmin((SampleType) 1, firstFade + (SampleType) i * fadeStep);
+            data[i] = previous[i] + fade * (data[i] - previous[i]);
+        }
+    }
+
+    // Copy the samples to the circular buffer, starting at writeIndex, in at most two pieces
+    void writeToDelay(const SampleType* data, int numSamples, SampleType* buffer) const
+    {
+        for (int i = 0, position = writeIndex; i < numSamples;)
+        {
+            const int numToCopy = jmin(numSamples - i, delayLength - position);
+            std::copy(data + i, data + i + numToCopy, buffer + position);
+
+            i += numToCopy;
+            position = (position + numToCopy) % delayLength;
+        }
+    }
+
+    // Copy the samples that were written delayInSamples before the ones at writeIndex
+    void readFromDelay(SampleType* data, int numSamples, const SampleType* buffer, int delayInSamples) const
+    {
+        for (int i = 0, position = (writeIndex - delayInSamples + delayLength) % delayLength; i < numSamples;)
+        {
+            const int numToCopy = jmin(numSamples - i, delayLength - position);
+            std::copy(buffer + position, buffer + position + numToCopy, data + i);
+
+            i += numToCopy;
+            position = (position + numToCopy) % delayLength;
+        }
+    }
+
+    GainComputer gainComputer;
+    SampleType threshold = 0, slope = 0;
+    bool linked = true;
+
+    double sampleRate = 44100;
+    int numChannels = 0;
+
+    // The lanes of the SIMD arrays, one per channel, rounded up to whole registers
+    int numLanes = 0;
+    std::vector<SampleType> laneStorage;
+    SampleType* levels = nullptr;       // the level of the last group in decibels
+    SampleType* reductions = nullptr;   // the smoothed gain reduction in decibels
+
+    std::vector<SampleType> peaks;      // the peak of the group so far
+    std::vector<SampleType> gains;      // the current linear gain
+    std::vector<SampleType> gainSteps;  // added to the gain each sample
+    int samplesUntilUpdate = detectorInterval;
+
+    dsp::AudioBlock<const SampleType> sidechain;
+
+    AudioBuffer<SampleType> delayBuffers;
+    int maxLookaheadSamples = 0;
+    int delayLength = detectorInterval;
+    int writeIndex = 0;
+    int lookahead = 0;
+    int previousLookahead = 0;
+    int crossfadeSamplesLeft = 0;
+    std::atomic<int> requestedLookahead { 0 };
+};
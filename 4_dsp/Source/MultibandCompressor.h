@@ -0,0 +1,420 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "CompressorGainComputer.h"
+
+// A compressor that splits the audio into 3 to 5 bands and compresses each of them separately, e.g. so that a loud bass
+// doesn't push down the vocals. It has the same prepare, process and reset functions as the dsp classes.
+//
+// The bands are split with Linkwitz-Riley crossovers: two 2nd order Butterworth filters in a row, low pass for the lower
+// band and high pass for the upper. The two outputs add up to an allpass, i.e. the sum is flat, and the crossover can't be
+// heard when nothing is compressed. With more bands, the upper output is split again at the next crossover. The lower bands
+// then miss the phase shift of the later crossovers, so they go through an allpass with the same phase instead:
+//
+//     band 0:  low pass 1, allpass 2, allpass 3, ...
+//     band 1:  high pass 1, low pass 2, allpass 3, ...
+//     band 2:  high pass 1, high pass 2, low pass 3, ...
+//
+// Each band is a chain of at most numSlots biquads. All the bands are processed at the same time, one band per lane
+// of a SIMD register: the input sample is copied to every lane, and each slot of the chain runs the biquads of every
+// band with one instruction. Slots that a band doesn't need are set to pass the audio through, and the lanes of the bands
+// that aren't in use output silence. Only the slots and registers that the current number of bands needs are run.
+// The detector and the gain computer are the ones of the LookaheadCompressor, from CompressorGainComputer.h, with a lane
+// per band, and at the end the lanes are added together. So the whole multiband process is one pass over the input, and
+// the bands never need buffers of their own.
+//
+// The crossovers can be changed from any thread. The new coefficients are designed on the audio thread at the start of the
+// next block, so that the filters never run with half of the coefficients updated.
+template <typename SampleType>
+class MultibandCompressor
+{
+public:
+
+    static constexpr int maxBands = 5;
+    static constexpr int maxCrossovers = maxBands - 1;
+
+    MultibandCompressor()
+    {
+        const SampleType defaultCrossovers[maxCrossovers] = { 120, 500, 2000, 6000 };
+
+        for (int i = 0; i < maxCrossovers; ++i)
+            crossovers[i] = defaultCrossovers[i];
+
+        // The coefficients, thresholds and slopes don't depend on the number of channels, so they're allocated right away
+        laneSettings.assign((size_t) numLaneSettings * numLanes + Vector::SIMDNumElements, 0);
+    }
+
+    // Can be called from any thread, the change happens on the next block
+    void setNumBands(int newNumBands) { requestedNumBands = jlimit(2, maxBands, newNumBands); crossoversChanged = true; }
+    void setCrossover(int index, SampleType frequency) { crossovers[index] = frequency; crossoversChanged = true; }
+
+    void setThreshold(int band, SampleType newThresholdDb) { getLaneSetting(thresholdSetting)[band] = newThresholdDb; }
+    void setRatio(int band, SampleType newRatio) { jassert(newRatio >= 1); getLaneSetting(slopeSetting)[band] = 1 / newRatio - 1; }
+
+    // These are the same for all bands
+    void setKnee(SampleType newKneeDb) { gainComputer.setKnee(newKneeDb); }
+    void setAttack(SampleType newAttackMs) { gainComputer.setAttack(newAttackMs); }
+    void setRelease(SampleType newReleaseMs) { gainComputer.setRelease(newReleaseMs); }
+    void setLinked(bool shouldBeLinked) { linked = shouldBeLinked; }
+
+    void prepare(const dsp::ProcessSpec& spec)
+    {
+        sampleRate = spec.sampleRate;
+        numChannels = (int) spec.numChannels;
+        gainComputer.prepare(sampleRate);
+
+        // All the state that changes per channel, allocated here so that process never allocates
+        filterStates.assign((size_t) numChannels * numSlots * 2 * numLanes + Vector::SIMDNumElements, 0);
+        detectorStates.assign((size_t) numChannels * numDetectorArrays * numLanes + Vector::SIMDNumElements, 0);
+
+        designCrossovers();
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(filterStates.begin(), filterStates.end(), (SampleType) 0);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            std::fill(getDetectorArray(ch, peakArray), getDetectorArray(ch, peakArray) + numLanes, (SampleType) 0);
+            std::fill(getDetectorArray(ch, gainArray), getDetectorArray(ch, gainArray) + numLanes, (SampleType) 1);
+            std::fill(getDetectorArray(ch, gainStepArray), getDetectorArray(ch, gainStepArray) + numLanes, (SampleType) 0);
+            std::fill(getDetectorArray(ch, reductionArray), getDetectorArray(ch, reductionArray) + numLanes, (SampleType) 0);
+        }
+
+        samplesUntilUpdate = detectorInterval;
+    }
+
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        auto&& inputBlock = context.getInputBlock();
+        auto&& outputBlock = context.getOutputBlock();
+
+        // The processing is done in place, so copy the input to the output first if they're different
+        if (context.usesSeparateInputAndOutputBlocks())
+            outputBlock.copyFrom(inputBlock);
+
+        if (context.isBypassed)
+        {
+            wasBypassed = true;
+            return;
+        }
+
+        jassert((int) outputBlock.getNumChannels() == numChannels);
+
+        // The filters and the detector haven't seen the audio while bypassed, so don't continue from where they stopped
+        if (wasBypassed)
+        {
+            reset();
+            wasBypassed = false;
+        }
+
+        if (crossoversChanged.exchange(false))
+        {
+            const bool numBandsChanged = (requestedNumBands != numBands);
+            designCrossovers();
+
+            // A different number of bands moves the bands to different lanes, so start from a clean state
+            if (numBandsChanged)
+                reset();
+        }
+
+        const int numSamples = (int) outputBlock.getNumSamples();
+
+        // Run until the next detector update at a time
+        for (int start = 0; start < numSamples;)
+        {
+            const int numInChunk = jmin(samplesUntilUpdate, numSamples - start);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                processChannel(outputBlock.getChannelPointer((size_t) ch) + start, numInChunk, ch);
+
+            start += numInChunk;
+            samplesUntilUpdate -= numInChunk;
+
+            if (samplesUntilUpdate == 0)
+            {
+                updateGains();
+                samplesUntilUpdate = detectorInterval;
+            }
+        }
+    }
+
+private:
+
+    using GainComputer = CompressorGainComputer<SampleType>;
+    using Vector = typename GainComputer::Vector;
+
+    // Enough registers to have a lane for every band
+    static constexpr int numVectors = (maxBands + (int) Vector::SIMDNumElements - 1) / (int) Vector::SIMDNumElements;
+    static constexpr int numLanes = numVectors * (int) Vector::SIMDNumElements;
+
+    // The longest chain of biquads: the top bands have the high passes of all crossovers, two biquads each
+    static constexpr int numSlots = 2 * maxCrossovers;
+
+    static constexpr int detectorInterval = GainComputer::detectorInterval;
+
+    // The settings that have a value for each lane: the five coefficients of each slot, the threshold and the slope
+    enum LaneSetting
+    {
+        thresholdSetting,
+        slopeSetting,
+        firstCoefficientSetting,
+        numLaneSettings = firstCoefficientSetting + numSlots * 5
+    };
+
+    enum DetectorArray
+    {
+        peakArray,          // the peak of the group so far
+        gainArray,          // the current linear gain
+        gainStepArray,      // added to the gain each sample
+        reductionArray,     // the smoothed gain reduction in decibels
+        numDetectorArrays
+    };
+
+    SampleType* getLaneSetting(int setting)
+    {
+        return Vector::getNextSIMDAlignedPtr(laneSettings.data()) + (size_t) setting * numLanes;
+    }
+
+    // b0, b1, b2, a1 and a2 are coefficients 0 to 4
+    SampleType* getCoefficients(int slot, int coefficient)
+    {
+        return getLaneSetting(firstCoefficientSetting + slot * 5 + coefficient);
+    }
+
+    SampleType* getFilterStates(int channel)
+    {
+        return Vector::getNextSIMDAlignedPtr(filterStates.data()) + (size_t) channel * numSlots * 2 * numLanes;
+    }
+
+    SampleType* getDetectorArray(int channel, DetectorArray array)
+    {
+        return Vector::getNextSIMDAlignedPtr(detectorStates.data()) + ((size_t) channel * numDetectorArrays + array) * numLanes;
+    }
+
+    // Fill the slots of each band as in the table at the top, and pass through in the rest
+    void designCrossovers()
+    {
+        numBands = requestedNumBands;
+
+        for (int slot = 0; slot < numSlots; ++slot)
+            for (int lane = 0; lane < numLanes; ++lane)
+                setCoefficients(slot, lane, { 1, 0, 0, 0, 0 });
+
+        // The crossovers must be in increasing order, and below Nyquist
+        SampleType frequencies[maxCrossovers];
+
+        for (int i = 0; i < numBands - 1; ++i)
+            frequencies[i] = jlimit(i > 0 ? frequencies[i - 1] : (SampleType) 10, (SampleType) (0.45 * sampleRate), (SampleType) crossovers[i]);
+
+        for (int band = 0; band < numLanes; ++band)
+        {
+            // The lanes of the bands that aren't in use are silent
+            if (band >= numBands)
+            {
+                setCoefficients(0, band, { 0, 0, 0, 0, 0 });
+                continue;
+            }
+
+            int slot = 0;
+
+            for (int i = 0; i < band; ++i)
+            {
+                setCoefficients(slot++, band, design(FilterType::highPass, frequencies[i]));
+                setCoefficients(slot++, band, design(FilterType::highPass, frequencies[i]));
+            }
+
+            if (band < numBands - 1)
+            {
+                setCoefficients(slot++, band, design(FilterType::lowPass, frequencies[band]));
+                setCoefficients(slot++, band, design(FilterType::lowPass, frequencies[band]));
+            }
+
+            for (int i = band + 1; i < numBands - 1; ++i)
+                setCoefficients(slot++, band, design(FilterType::allPass, frequencies[i]));
+
+            jassert(slot <= numSlots);
+        }
+    }
+
+    enum class FilterType
+    {
+        lowPass,
+        highPass,
+        allPass
+    };
+
+    struct Coefficients
+    {
+        SampleType b0, b1, b2, a1, a2;
+    };
+
+    // Butterworth biquads from the Audio EQ Cookbook, normalised so that a0 is 1
+    Coefficients design(FilterType type, SampleType frequency) const
+    {
+        const double w0 = MathConstants<double>::twoPi * frequency / sampleRate;
+        const double cosw0 = std::cos(w0);
+        const double q = 1 / MathConstants<double>::sqrt2;
+        const double alpha = std::sin(w0) / (2 * q);
+        const double a0 = 1 + alpha;
+
+        double b0 = 0, b1 = 0, b2 = 0;
+
+        switch (type)
+        {
+            case FilterType::lowPass:  b0 = (1 - cosw0) / 2;  b1 = 1 - cosw0;    b2 = b0;          break;
+            case FilterType::highPass: b0 = (1 + cosw0) / 2;  b1 = -(1 + cosw0); b2 = b0;          break;
+            case FilterType::allPass:  b0 = 1 - alpha;        b1 = -2 * cosw0;   b2 = 1 + alpha;   break;
+        }
+
+        return { (SampleType) (b0 / a0), (SampleType) (b1 / a0), (SampleType) (b2 / a0),
+                 (SampleType) (-2 * cosw0 / a0), (SampleType) ((1 - alpha) / a0) };
+    }
+
+    void setCoefficients(int slot, int lane, const Coefficients& c)
+    {
+        getCoefficients(slot, 0)[lane] = c.b0;
+        getCoefficients(slot, 1)[lane] = c.b1;
+        getCoefficients(slot, 2)[lane] = c.b2;
+        getCoefficients(slot, 3)[lane] = c.a1;
+        getCoefficients(slot, 4)[lane] = c.a2;
+    }
+
+    // Split, detect, apply the gains and sum, for one channel. The filter states are kept in registers during the loop.
+    // Only the slots and registers that the current number of bands uses are run, the others would only pass through.
+    void processChannel(SampleType* data, int numSamples, int channel)
+    {
+        SampleType* states = getFilterStates(channel);
+        SampleType* peaks = getDetectorArray(channel, peakArray);
+        SampleType* gains = getDetectorArray(channel, gainArray);
+        SampleType* gainSteps = getDetectorArray(channel, gainStepArray);
+
+        // The top band has the high passes of all crossovers, the longest chain in use
+        const int numActiveSlots = 2 * (numBands - 1);
+        const int numActiveVectors = (numBands + (int) Vector::SIMDNumElements - 1) / (int) Vector::SIMDNumElements;
+
+        Vector z1[numVectors][numSlots], z2[numVectors][numSlots];
+        Vector peak[numVectors], gain[numVectors], gainStep[numVectors];
+
+        for (int v = 0; v < numActiveVectors; ++v)
+        {
+            const int lane = v * (int) Vector::SIMDNumElements;
+
+            for (int s = 0; s < numActiveSlots; ++s)
+            {
+                z1[v][s] = Vector::fromRawArray(states + (2 * s) * numLanes + lane);
+                z2[v][s] = Vector::fromRawArray(states + (2 * s + 1) * numLanes + lane);
+            }
+
+            peak[v] = Vector::fromRawArray(peaks + lane);
+            gain[v] = Vector::fromRawArray(gains + lane);
+            gainStep[v] = Vector::fromRawArray(gainSteps + lane);
+        }
+
+        const Vector zero = Vector::expand(0);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const Vector input = Vector::expand(data[i]);
+            Vector sum = zero;
+
+            for (int v = 0; v < numActiveVectors; ++v)
+            {
+                const int lane = v * (int) Vector::SIMDNumElements;
+                Vector x = input;
+
+                // Transposed direct form II, the same for every lane
+                for (int s = 0; s < numActiveSlots; ++s)
+                {
+                    const Vector y = Vector::fromRawArray(getCoefficients(s, 0) + lane) * x + z1[v][s];
+
+                    z1[v][s] = Vector::fromRawArray(getCoefficients(s, 1) + lane) * x - Vector::fromRawArray(getCoefficients(s, 3) + lane) * y + z2[v][s];
+                    z2[v][s] = Vector::fromRawArray(getCoefficients(s, 2) + lane) * x - Vector::fromRawArray(getCoefficients(s, 4) + lane) * y;
+                    x = y;
+                }
+
+                peak[v] = Vector::max(peak[v], Vector::max(x, zero - x));
+                gain[v] = gain[v] + gainStep[v];
+                sum = sum + x * gain[v];
+            }
+
+            // Adding the lanes together is the slow part, so it's done once for all registers
+            data[i] = sum.sum();
+        }
+
+        for (int v = 0; v < numActiveVectors; ++v)
+        {
+            const int lane = v * (int) Vector::SIMDNumElements;
+
+            for (int s = 0; s < numActiveSlots; ++s)
+            {
+                z1[v][s].copyToRawArray(states + (2 * s) * numLanes + lane);
+                z2[v][s].copyToRawArray(states + (2 * s + 1) * numLanes + lane);
+            }
+
+            peak[v].copyToRawArray(peaks + lane);
+            gain[v].copyToRawArray(gains + lane);
+        }
+    }
+
+    // Take the peaks of the group that just ended, and set the gains to ramp to the new values during the next group
+    void updateGains()
+    {
+        // When linked, each band takes the loudest channel of that band
+        if (linked)
+        {
+            for (int lane = 0; lane < numLanes; ++lane)
+            {
+                SampleType loudest = 0;
+
+                for (int ch = 0; ch < numChannels; ++ch)
+                    loudest = jmax(loudest, getDetectorArray(ch, peakArray)[lane]);
+
+                for (int ch = 0; ch < numChannels; ++ch)
+                    getDetectorArray(ch, peakArray)[lane] = loudest;
+            }
+        }
+
+        alignas(Vector::SIMDRegisterSize) SampleType levels[numLanes];
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            SampleType* gains = getDetectorArray(ch, gainArray);
+            SampleType* reductions = getDetectorArray(ch, reductionArray);
+
+            GainComputer::takeLevels(getDetectorArray(ch, peakArray), levels, numLanes);
+
+            // For all bands a register at a time, each with its own threshold and slope
+            for (int lane = 0; lane < numLanes; lane += (int) Vector::SIMDNumElements)
+                gainComputer.computeReduction(Vector::fromRawArray(levels + lane),
+                                              Vector::fromRawArray(getLaneSetting(thresholdSetting) + lane),
+                                              Vector::fromRawArray(getLaneSetting(slopeSetting) + lane),
+                                              Vector::fromRawArray(reductions + lane)).copyToRawArray(reductions + lane);
+
+            GainComputer::setGainSteps(reductions, gains, getDetectorArray(ch, gainStepArray), numLanes);
+        }
+    }
+
+    // A numLanes array for each LaneSetting
+    std::vector<SampleType> laneSettings;
+
+    GainComputer gainComputer;
+    bool linked = true;
+
+    std::atomic<SampleType> crossovers[maxCrossovers];
+    std::atomic<int> requestedNumBands { 3 };
+    std::atomic<bool> crossoversChanged { true };
+    int numBands = 3;
+
+    double sampleRate = 44100;
+    int numChannels = 0;
+
+    // For each channel: the two states of each slot, and the detector arrays. A lane per band in each.
+    std::vector<SampleType> filterStates;
+    std::vector<SampleType> detectorStates;
+    int samplesUntilUpdate = detectorInterval;
+    bool wasBypassed = false;
+};
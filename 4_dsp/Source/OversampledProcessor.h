@@ -0,0 +1,155 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Runs another processor at a higher samplerate, e.g. a saturator, inside a ProcessorChain.
+//
+// Saturation creates harmonics above the original frequencies. Those that would go above Nyquist fold back down, i.e. alias,
+// to frequencies that have nothing to do with the original sound. With high saturation gains this is clearly audible,
+// especially on high notes. Running the saturator at 2x, 4x or 8x the samplerate gives the harmonics room above the
+// audible range, and the downsampling filter removes them before they can fold back.
+//
+// Only the wrapped processor runs at the higher samplerate, not the whole plugin. The up- and downsampling is done by
+// dsp::Oversampling, with either of its half-band filters:
+//     polyphase IIR: cheap and short latency, but shifts the phase of the high frequencies a little
+//     FIR: linear phase, but more CPU and latency
+//
+// Both filters of all factors are allocated in prepare, so the oversampling can be changed while playing without
+// allocating on the audio thread. When it changes, the wrapped processor is prepared again for the new samplerate
+// on the audio thread, so its prepare must not allocate when the number of channels stays the same. That's the case
+// for the simple dsp classes such as Gain.
+//
+// The filters delay the signal, see getLatencyInSamples.
+template <typename ProcessorType>
+class OversampledProcessor
+{
+public:
+
+    using SampleType = float;
+
+    enum class FilterType
+    {
+        polyphaseIIR,
+        FIR
+    };
+
+    // The oversampling factor is 2 ^ order, i.e. 8x at most
+    static constexpr int maxOrder = 3;
+
+    // The processor that runs at the higher samplerate
+    ProcessorType& getProcessor() { return processor; }
+
+    // Set the oversampling, order 0 means no oversampling. Can be called from any thread, the change happens on the next block.
+    void setOversampling(int order, FilterType filterType)
+    {
+        requestedSetting = getSettingIndex(jlimit(0, maxOrder, order), filterType);
+    }
+
+    // The delay of the output in samples at the normal samplerate, with the given oversampling.
+    // Valid after prepare, so that the processor can report it to the host.
+    int getLatencyInSamples(int order, FilterType filterType) const
+    {
+        if (order <= 0 || oversamplers[getSettingIndex(order, filterType)] == nullptr)
+            return 0;
+
+        return roundToInt(oversamplers[getSettingIndex(order, filterType)]->getLatencyInSamples());
+    }
+
+    void prepare(const dsp::ProcessSpec& newSpec)
+    {
+        spec = newSpec;
+
+        for (int order = 1; order <= maxOrder; ++order)
+        {
+            for (const auto filterType : { FilterType::polyphaseIIR, FilterType::FIR })
+            {
+                const auto type = (filterType == FilterType::FIR) ? dsp::Oversampling<SampleType>::filterHalfBandFIREquiripple
+                                                                  : dsp::Oversampling<SampleType>::filterHalfBandPolyphaseIIR;
+
+                // The last argument asks for a whole number of samples of latency, so getLatencyInSamples is exact after rounding
+                auto& oversampler = oversamplers[getSettingIndex(order, filterType)];
+                oversampler.reset(new dsp::Oversampling<SampleType> (spec.numChannels, order, type, true, true));
+                oversampler->initProcessing(spec.maximumBlockSize);
+            }
+        }
+
+        activate(requestedSetting);
+    }
+
+    void reset()
+    {
+        if (activeOversampler != nullptr)
+            activeOversampler->reset();
+
+        processor.reset();
+    }
+
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        const int setting = requestedSetting;
+
+        if (setting != activeSetting)
+            activate(setting);
+
+        if (activeOversampler == nullptr)
+        {
+            processor.process(context);
+            return;
+        }
+
+        auto& outputBlock = context.getOutputBlock();
+
+        // The oversampler works in place, so copy the input to the output first if they're different
+        if (context.usesSeparateInputAndOutputBlocks())
+            outputBlock.copyFrom(context.getInputBlock());
+
+        if (context.isBypassed)
+            return;
+
+        // Upsample, process at the higher samplerate, and downsample back. The oversampler only has room for
+        // spec.maximumBlockSize samples, and the host can send longer blocks than it said, so go in pieces of at most that.
+        const int numSamples = (int) outputBlock.getNumSamples();
+        const int maxPieceSize = (int) spec.maximumBlockSize;
+
+        for (int start = 0; start < numSamples; start += maxPieceSize)
+        {
+            auto piece = outputBlock.getSubBlock((size_t) start, (size_t) jmin(maxPieceSize, numSamples - start));
+
+            auto oversampledBlock = activeOversampler->processSamplesUp(piece);
+            processor.process(dsp::ProcessContextReplacing<SampleType> (oversampledBlock));
+            activeOversampler->processSamplesDown(piece);
+        }
+    }
+
+private:
+
+    // The settings are numbered so that the order and filter type fit in one atomic int
+    static int getSettingIndex(int order, FilterType filterType) { return order * 2 + (int) filterType; }
+
+    // Take a setting into use, starting from a clean state
+    void activate(int setting)
+    {
+        activeSetting = setting;
+
+        const int order = setting / 2;
+        activeOversampler = (order > 0) ? oversamplers[setting].get() : nullptr;
+
+        if (activeOversampler != nullptr)
+            activeOversampler->reset();
+
+        processor.prepare({ spec.sampleRate * (1 << order), spec.maximumBlockSize << order, spec.numChannels });
+        processor.reset();
+    }
+
+    ProcessorType processor;
+
+    dsp::ProcessSpec spec { 44100, 512, 1 };
+
+    // Indexed with getSettingIndex, the ones with order 0 aren't used
+    std::unique_ptr<dsp::Oversampling<SampleType>> oversamplers[(maxOrder + 1) * 2];
+    dsp::Oversampling<SampleType>* activeOversampler = nullptr;
+
+    std::atomic<int> requestedSetting { 0 };
+    int activeSetting = -1;
+};
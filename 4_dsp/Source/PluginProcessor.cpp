@@ -4,24 +4,68 @@
 //==============================================================================
 DspexampleAudioProcessor::DspexampleAudioProcessor()
      : AudioProcessor (BusesProperties()
-                       .withInput  ("Input",  juce::AudioChannelSet::mono(), true)
-                       .withOutput ("Output", juce::AudioChannelSet::mono(), true)
+                       .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
+                       // The second input bus is the sidechain. It's disabled by default, the host enables it if the user wants to use it.
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
                        )
 {
     // To save space, we can combine creating a parameter with adding the parameter
     // In C++, an equal operator '=' typically returns a reference to the value that was assigned.
     addParameter(saturationParam = new AudioParameterFloat("saturation", "Saturation", 0.01, 100, 1));
+    addParameter(saturationTypeParam = new AudioParameterChoice("saturationtype", "Saturation Type", { "Exact", "Fast", "Accurate" }, 2));
+    addParameter(oversamplingParam = new AudioParameterChoice("oversampling", "Oversampling", { "Off", "2x", "4x", "8x" }, 0));
+    addParameter(oversamplingFilterParam = new AudioParameterChoice("oversamplingfilter", "Oversampling Filter", { "Polyphase IIR", "Linear Phase FIR" }, 0));
     addParameter(thresholdParam = new AudioParameterFloat("threshold", "Threshold (dB)", -60, 0, -10));
     addParameter(ratioParam = new AudioParameterFloat("ratio", "Ratio", 1, 20, 4));
     addParameter(attackParam = new AudioParameterFloat("attack", "Attack (ms)", 1, 30, 12));
     addParameter(releaseParam = new AudioParameterFloat("release", "Release (ms)", 1, 300, 150));
+    addParameter(kneeParam = new AudioParameterFloat("knee", "Knee (dB)", 0, 24, 6));
+    addParameter(lookaheadParam = new AudioParameterFloat("lookahead", "Lookahead (ms)", 0, LookaheadCompressor<float>::maxLookaheadMs, 0));
+    addParameter(linkParam = new AudioParameterBool("link", "Channel Link", true));
+    addParameter(sidechainParam = new AudioParameterBool("sidechain", "External Sidechain", false));
+    addParameter(multibandParam = new AudioParameterChoice("multiband", "Multiband", { "Off", "3 Bands", "4 Bands", "5 Bands" }, 0));
+    
+    // The multiband parameters are the same for each band and crossover, so they're created in loops.
+    // The ids and names get the number of the band, starting from 1, e.g. "band1threshold".
+    const float defaultCrossovers[] = { 120, 500, 2000, 6000 };
+    
+    for (int i = 0; i < (int) crossoverParams.size(); ++i)
+    {
+        const juce::String number (i + 1);
+        addParameter(crossoverParams[i] = new AudioParameterFloat("crossover" + number, "Crossover " + number + " (Hz)", 20, 20000, defaultCrossovers[i]));
+    }
+    
+    for (int i = 0; i < (int) bandThresholdParams.size(); ++i)
+    {
+        const juce::String number (i + 1);
+        addParameter(bandThresholdParams[i] = new AudioParameterFloat("band" + number + "threshold", "Band " + number + " Threshold (dB)", -60, 0, -10));
+        addParameter(bandRatioParams[i] = new AudioParameterFloat("band" + number + "ratio", "Band " + number + " Ratio", 1, 20, 4));
+    }
 
     // Register our AudioProcessor as a listener of the parameters
     saturationParam->addListener(this);
+    saturationTypeParam->addListener(this);
+    oversamplingParam->addListener(this);
+    oversamplingFilterParam->addListener(this);
     thresholdParam->addListener(this);
     ratioParam->addListener(this);
     attackParam->addListener(this);
     releaseParam->addListener(this);
+    kneeParam->addListener(this);
+    lookaheadParam->addListener(this);
+    linkParam->addListener(this);
+    sidechainParam->addListener(this);
+    multibandParam->addListener(this);
+    
+    for (auto* param : crossoverParams)
+        param->addListener(this);
+    
+    for (int i = 0; i < (int) bandThresholdParams.size(); ++i)
+    {
+        bandThresholdParams[i]->addListener(this);
+        bandRatioParams[i]->addListener(this);
+    }
 }
 
 DspexampleAudioProcessor::~DspexampleAudioProcessor()
@@ -84,26 +128,13 @@ void DspexampleAudioProcessor::prepareToPlay (double sampleRate, int samplesPerB
     // Here we define a variable of type ProcessSpec and name spec, and use a struct initialiser recognised by the curly brackets.
     // This assigns the provided values in the order they are in the struct. Then we give the struct to .prepare() method.
     
-    juce::dsp::ProcessSpec spec { sampleRate, (uint32)samplesPerBlock, (uint32)getTotalNumInputChannels() };
+    // The number of channels is that of the main bus only. The total number of input channels would include the sidechain.
+    juce::dsp::ProcessSpec spec { sampleRate, (uint32)samplesPerBlock, (uint32)getMainBusNumInputChannels() };
     processorChain.prepare(spec);
     
     // Now that we have setup the processors, we can push all parameter values to their corresponding settings.
     // Let's use the bool flag in propagateParameterValue to do this.
     propagateParameterValue(-1, true);
-    
-    // Get an easier handle to the waveshaper. Get the corresponding dsp module from the processorChain with get<i>(), where
-    // i is the index of the processor.
-    //
-    // C++ always requires a type of a variable when declared, but 'auto' can be used to automatically deduce the type. By using auto&, we instruct the compiler
-    // that the auto should be a reference instead of a value. Be warned, if you forget the &, the compiler may copy the dsp module
-    // instead of getting a reference to it, and all of the changes would be applied to the copy instead of the original, i.e. nothing would be changed.
-    auto& waveshaper = processorChain.get<waveshaperIndex>();
-    
-    // Set the function to use for the distortion. The syntax used here is the lambda syntax, i.e. it is a function without a name.
-    waveshaper.functionToUse = [] (float x)
-    {
-        return std::tanh (x);
-    };
 }
 
 void DspexampleAudioProcessor::releaseResources()
@@ -113,13 +144,11 @@ void DspexampleAudioProcessor::releaseResources()
 
 bool DspexampleAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
-    if (layouts.getMainInputChannelSet() == juce::AudioChannelSet::mono()
-        && layouts.getMainOutputChannelSet() == juce::AudioChannelSet::mono())
-    {
-        return true;
-    }
+    // Any number of channels works, as long as the output has the same channels as the input.
+    // The sidechain can have any number of channels too, or be disabled, so it isn't checked.
+    const juce::AudioChannelSet& inputLayout = layouts.getMainInputChannelSet();
     
-    return false;
+    return ! inputLayout.isDisabled() && inputLayout == layouts.getMainOutputChannelSet();
 }
 
 void DspexampleAudioProcessor::parameterValueChanged (int parameterIndex, float /*newValue*/)
@@ -146,9 +175,34 @@ void DspexampleAudioProcessor::propagateParameterValue(int parameterIndex, bool
     
     if (parameterIndex == saturationParam->getParameterIndex() || all)
     {
-        const float saturationGain = *saturationParam;
-        processorChain.get<preSaturationGainIndex>().setGainLinear(saturationGain);
-        processorChain.get<postSaturationGainIndex>().setGainLinear(1.0f / saturationGain);
+        getSaturator().setDrive(*saturationParam);
+        if (!all) return;
+    }
+    if (parameterIndex == saturationTypeParam->getParameterIndex() || all)
+    {
+        // Get an easier handle to the saturator. Get the corresponding dsp module from the processorChain with get<i>(), where
+        // i is the index of the processor.
+        //
+        // C++ always requires a type of a variable when declared, but 'auto' can be used to automatically deduce the type. By using auto&, we instruct the compiler
+        // that the auto should be a reference instead of a value. Be warned, if you forget the &, the compiler may copy the dsp module
+        // instead of getting a reference to it, and all of the changes would be applied to the copy instead of the original, i.e. nothing would be changed.
+        auto& saturator = getSaturator();
+        
+        // The choices are in the same order as the approximations
+        saturator.setApproximation(static_cast<Saturator<float>::Approximation>(saturationTypeParam->getIndex()));
+        if (!all) return;
+    }
+    if (parameterIndex == oversamplingParam->getParameterIndex() || parameterIndex == oversamplingFilterParam->getParameterIndex() || all)
+    {
+        // The choices are "Off", "2x", "4x" and "8x", so the index is the oversampling order: the factor is 2 ^ index
+        const int order = oversamplingParam->getIndex();
+        const auto filterType = static_cast<OversampledProcessor<Saturator<float>>::FilterType>(oversamplingFilterParam->getIndex());
+        
+        auto& oversampledSaturation = processorChain.get<saturatorIndex>();
+        oversampledSaturation.setOversampling(order, filterType);
+        
+        // The up- and downsampling filters delay the signal, tell the host so that it can compensate
+        updateLatency();
         if (!all) return;
     }
     if (parameterIndex == thresholdParam->getParameterIndex() || all)
@@ -164,13 +218,82 @@ void DspexampleAudioProcessor::propagateParameterValue(int parameterIndex, bool
     if (parameterIndex == attackParam->getParameterIndex() || all)
     {
         processorChain.get<compressorIndex>().setAttack(*attackParam);
+        processorChain.get<multibandIndex>().setAttack(*attackParam);
         if (!all) return;
     }
     if (parameterIndex == releaseParam->getParameterIndex() || all)
     {
         processorChain.get<compressorIndex>().setRelease(*releaseParam);
+        processorChain.get<multibandIndex>().setRelease(*releaseParam);
         if (!all) return;
     }
+    if (parameterIndex == kneeParam->getParameterIndex() || all)
+    {
+        processorChain.get<compressorIndex>().setKnee(*kneeParam);
+        processorChain.get<multibandIndex>().setKnee(*kneeParam);
+        if (!all) return;
+    }
+    if (parameterIndex == lookaheadParam->getParameterIndex() || all)
+    {
+        processorChain.get<compressorIndex>().setLookahead(*lookaheadParam);
+        updateLatency();
+        if (!all) return;
+    }
+    if (parameterIndex == linkParam->getParameterIndex() || all)
+    {
+        processorChain.get<compressorIndex>().setLinked(*linkParam);
+        processorChain.get<multibandIndex>().setLinked(*linkParam);
+        if (!all) return;
+    }
+    if (parameterIndex == multibandParam->getParameterIndex() || all)
+    {
+        // The choices are "Off", "3 Bands", "4 Bands" and "5 Bands", so the number of bands is the index + 2
+        const bool isMultiband = multibandParam->getIndex() > 0;
+        
+        if (isMultiband)
+            processorChain.get<multibandIndex>().setNumBands(multibandParam->getIndex() + 2);
+        
+        // A bypassed processor in a ProcessorChain doesn't process the audio, so only one of the compressors is active
+        processorChain.setBypassed<compressorIndex>(isMultiband);
+        processorChain.setBypassed<multibandIndex>(!isMultiband);
+        
+        // The lookahead only applies to the single band compressor
+        updateLatency();
+        if (!all) return;
+    }
+    for (int i = 0; i < (int) crossoverParams.size(); ++i)
+    {
+        if (parameterIndex == crossoverParams[i]->getParameterIndex() || all)
+        {
+            processorChain.get<multibandIndex>().setCrossover(i, *crossoverParams[i]);
+            if (!all) return;
+        }
+    }
+    for (int i = 0; i < (int) bandThresholdParams.size(); ++i)
+    {
+        if (parameterIndex == bandThresholdParams[i]->getParameterIndex() || all)
+        {
+            processorChain.get<multibandIndex>().setThreshold(i, *bandThresholdParams[i]);
+            if (!all) return;
+        }
+        if (parameterIndex == bandRatioParams[i]->getParameterIndex() || all)
+        {
+            processorChain.get<multibandIndex>().setRatio(i, *bandRatioParams[i]);
+            if (!all) return;
+        }
+    }
+    // The sidechain parameter is read in processBlock, nothing to do here
+}
+
+void DspexampleAudioProcessor::updateLatency()
+{
+    const int order = oversamplingParam->getIndex();
+    const auto filterType = static_cast<OversampledProcessor<Saturator<float>>::FilterType>(oversamplingFilterParam->getIndex());
+    
+    const bool isMultiband = multibandParam->getIndex() > 0;
+    
+    setLatencySamples(processorChain.get<saturatorIndex>().getLatencyInSamples(order, filterType)
+                      + (isMultiband ? 0 : processorChain.get<compressorIndex>().getLatencyInSamples()));
 }
 
 // Body of the function intentionally left blank
@@ -184,9 +307,22 @@ void DspexampleAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, j
     // The AudioBlock is then wrapped inside a context. Several types of contexts exist, here we're
     // using ProcessContextReplacing, which replaces the samples of the buffer with processed samples.
     
-    juce::dsp::AudioBlock<float> audioBlock (buffer);
+    // The buffer has the channels of all the input buses, so take the main bus, i.e. bus 0, for processing.
+    // The AudioBlock only points to the channels of the buffer, and so does a block of some of its channels. getBusBuffer
+    // would make an AudioBuffer instead, which allocates its channel list when there are more than 32 channels.
+    juce::dsp::AudioBlock<float> bufferBlock (buffer);
+    juce::dsp::AudioBlock<float> audioBlock = bufferBlock.getSubsetChannelBlock((size_t) getChannelIndexInProcessBlockBuffer(true, 0, 0),
+                                                                                (size_t) getMainBusNumInputChannels());
     juce::dsp::ProcessContextReplacing<float> context (audioBlock);
 
+    // If the sidechain is in use, the compressor listens to bus 1 instead of the main input. The multiband compressor doesn't have a sidechain.
+    if (*sidechainParam && getBusCount(true) > 1 && getChannelCountOfBus(true, 1) > 0)
+    {
+        juce::dsp::AudioBlock<float> sidechainBlock = bufferBlock.getSubsetChannelBlock((size_t) getChannelIndexInProcessBlockBuffer(true, 1, 0),
+                                                                                        (size_t) getChannelCountOfBus(true, 1));
+        processorChain.get<compressorIndex>().setSidechain(sidechainBlock);
+    }
+
     processorChain.process(context);
 }
 
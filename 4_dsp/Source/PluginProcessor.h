@@ -1,6 +1,10 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "Saturator.h"
+#include "OversampledProcessor.h"
+#include "LookaheadCompressor.h"
+#include "MultibandCompressor.h"
 
 // This example demonstrates the minimum steps needed to use the juce::dsp's classes for audio processing in a plug-in.
 
@@ -25,6 +29,9 @@ public:
     // The added bool flag can be used to force all parameters to propagate values, and is used in prepareToPlay().
     // The flag has a default value of false, so if not specified when calling the function, all won't be updated.
     void propagateParameterValue (int parameterIndex, bool all = false);
+    
+    // The oversampling and the lookahead both delay the audio, this reports their sum to the host
+    void updateLatency();
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
 
@@ -59,6 +66,17 @@ private:
     juce::AudioParameterFloat* attackParam;
     juce::AudioParameterFloat* releaseParam;
     juce::AudioParameterFloat* saturationParam;
+    juce::AudioParameterChoice* saturationTypeParam;
+    juce::AudioParameterChoice* oversamplingParam;
+    juce::AudioParameterChoice* oversamplingFilterParam;
+    juce::AudioParameterFloat* kneeParam;
+    juce::AudioParameterFloat* lookaheadParam;
+    juce::AudioParameterBool* linkParam;
+    juce::AudioParameterBool* sidechainParam;
+    juce::AudioParameterChoice* multibandParam;
+    std::array<juce::AudioParameterFloat*, MultibandCompressor<float>::maxCrossovers> crossoverParams;
+    std::array<juce::AudioParameterFloat*, MultibandCompressor<float>::maxBands> bandThresholdParams;
+    std::array<juce::AudioParameterFloat*, MultibandCompressor<float>::maxBands> bandRatioParams;
 
     // An anonymous enum, that is, an enumeration without a name. Enumerations assign easy-to-remember names to index values.
     // If nothing else is specified, the first enumeration name gets the index 0, and all consecutive names get consecutive numbers, i.e. 1, 2, and 3.
@@ -67,23 +85,28 @@ private:
     // This enum is used for convenience to access the processors in the processorChain, defined below. Pay attention to have
     // the indices of the enum in the same order as the ProcessorChain members.
     enum {
-        preSaturationGainIndex,
-        waveshaperIndex,
-        postSaturationGainIndex,
-        compressorIndex
+        saturatorIndex,
+        compressorIndex,
+        multibandIndex
     };
     
     // A ProcessorChain links together several processors, and calls them one after another in the order they were declared.
     // Since it is a template class, the order can't be altered from the declaration order.
     //
-    // WaveShaper as it is doesn't support additional parameters to the waveshaping function, so we apply gain and inverse gain before and after it.
+    // The Saturator is our own class, not a part of JUCE, but it has the same prepare, process and reset functions as the dsp classes,
+    // so it can be used in a ProcessorChain the same way. It applies the saturation gain and its inverse around the curve itself.
+    // It's wrapped in an OversampledProcessor, so that only the saturation runs at the higher samplerate.
+    // The LookaheadCompressor is our own too, it replaces dsp::Compressor, which has no lookahead, knee or sidechain.
+    // The MultibandCompressor is used instead of it when the multiband parameter is on, only one of them is active at a time.
     juce::dsp::ProcessorChain
     <
-        juce::dsp::Gain<float>,
-        juce::dsp::WaveShaper<float>,
-        juce::dsp::Gain<float>,
-        juce::dsp::Compressor<float>
+        OversampledProcessor<Saturator<float>>,
+        LookaheadCompressor<float>,
+        MultibandCompressor<float>
     > processorChain;
+    
+    // A shorthand for the saturator inside the oversampler
+    Saturator<float>& getSaturator() { return processorChain.get<saturatorIndex>().getProcessor(); }
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DspexampleAudioProcessor)
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// A tanh saturator with drive, that can be used in a ProcessorChain in place of a WaveShaper.
+//
+// The WaveShaper calls its functionToUse for every sample. The function is a std::function, so the compiler can't see what
+// it does, and has to make an actual function call for every sample, which in turn calls std::tanh. std::tanh is accurate
+// to the last bit, but that takes dozens of instructions per sample.
+//
+// This saturator knows the function at compile time, and approximates tanh with a rational function, i.e. a polynomial
+// divided by another polynomial. They are Padé approximants: the Taylor series of the rational function matches that of tanh
+// as far as it can. They're only good up to some limit, so the input is clamped there. At the limit the approximation is
+// exactly 1, so the curve stays continuous.
+//
+//     fast:     x (27 + x^2) / (27 + 9 x^2), clamped to +-3. Off by at most 0.024, a slightly harder knee than tanh.
+//     accurate: the 7th order Padé approximant, clamped to +-4.97. Off by at most 0.0001, which can't be heard.
+//     exact:    std::tanh, for comparison.
+//
+// The program in Benchmark/ checks these errors against std::tanh, and measures the cost of each one.
+//
+// The approximations only need multiplications and additions, so they are vectorised with SIMDRegister: 4 or 8 floats
+// are processed with one instruction. SIMDRegister doesn't have division though, since not all SIMD instruction sets
+// have it. So instead of dividing by the denominator, we multiply by its reciprocal, found with Newton-Raphson iterations
+// that need only multiplications. We know the range of the denominator, so we know how many iterations are needed
+// to make the error of the reciprocal smaller than the error of the approximation itself.
+//
+// The drive gain is applied before the curve and its inverse after it, i.e. tanh(drive * x) / drive, so that small signals
+// pass at unity gain. Doing it here instead of with Gain processors around the saturator means that each sample is read
+// and written only once, and the gains are applied while the sample is still in a register.
+//
+// Changes of the drive are smoothed, so that turning the knob doesn't click. The drive and its inverse are both ramped
+// multiplicatively with the same number of steps, so they stay each other's inverse during the ramp without any division.
+//
+// SampleType is float or double, like in the juce::dsp classes.
+template <typename SampleType>
+class Saturator
+{
+public:
+
+    enum class Approximation
+    {
+        exact,
+        fast,
+        accurate
+    };
+
+    void setApproximation(Approximation newApproximation) { approximation = newApproximation; }
+    Approximation getApproximation() const { return approximation; }
+
+    // The gain before the curve, must be above zero. The inverse is applied after it.
+    void setDrive(SampleType newDrive)
+    {
+        jassert(newDrive > 0);
+        drive.setTargetValue(newDrive);
+        compensation.setTargetValue(1 / newDrive);
+    }
+
+    // Doesn't allocate, so it can be called again on the audio thread, e.g. by an OversampledProcessor
+    void prepare(const dsp::ProcessSpec& spec)
+    {
+        drive.reset(spec.sampleRate, rampLengthSeconds);
+        compensation.reset(spec.sampleRate, rampLengthSeconds);
+    }
+
+    // Jump to the current drive without ramping
+    void reset()
+    {
+        drive.setCurrentAndTargetValue(drive.getTargetValue());
+        compensation.setCurrentAndTargetValue(compensation.getTargetValue());
+    }
+
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        auto&& inputBlock = context.getInputBlock();
+        auto&& outputBlock = context.getOutputBlock();
+
+        // The processing is done in place, so copy the input to the output first if they're different
+        if (context.usesSeparateInputAndOutputBlocks())
+            outputBlock.copyFrom(inputBlock);
+
+        if (context.isBypassed)
+        {
+            drive.skip((int) outputBlock.getNumSamples());
+            compensation.skip((int) outputBlock.getNumSamples());
+            return;
+        }
+
+        switch (approximation)
+        {
+            case Approximation::exact:    processBlock<ExactTanh>(outputBlock); break;
+            case Approximation::fast:     processBlock<FastTanh>(outputBlock); break;
+            case Approximation::accurate: processBlock<AccurateTanh>(outputBlock); break;
+        }
+    }
+
+    using Vector = dsp::SIMDRegister<SampleType>;
+
+    // The approximations for a whole register of samples. They're public so that they can be compared with std::tanh.
+    struct FastTanh
+    {
+        static constexpr SampleType limit = 3;
+
+        static Vector apply(Vector x)
+        {
+            x = Vector::min(Vector::max(x, Vector::expand(-limit)), Vector::expand(limit));
+            const Vector x2 = x * x;
+
+            const Vector numerator = x * (x2 + Vector::expand(27));
+            const Vector denominator = x2 * Vector::expand(9) + Vector::expand(27);
+
+            // The denominator is from 27 to 27 + 9 * 3^2
+            return numerator * reciprocal<3>(denominator, 27, 108);
+        }
+
+        // A single sample, through a register so that it gets exactly the same result
+        static SampleType apply(SampleType x) { return apply(Vector::expand(x)).get(0); }
+    };
+
+    struct AccurateTanh
+    {
+        static constexpr SampleType limit = (SampleType) 4.97178685;
+
+        static Vector apply(Vector x)
+        {
+            x = Vector::min(Vector::max(x, Vector::expand(-limit)), Vector::expand(limit));
+            const Vector x2 = x * x;
+
+            // Horner's method: evaluate the polynomials from the highest power down, one multiply and add per term
+            const Vector numerator = x * (((x2 + Vector::expand(378)) * x2 + Vector::expand(17325)) * x2 + Vector::expand(135135));
+            const Vector denominator = ((x2 * Vector::expand(28) + Vector::expand(3150)) * x2 + Vector::expand(62370)) * x2 + Vector::expand(135135);
+
+            // The denominator is from 135135 to about 4.02 million, such a wide range needs more iterations
+            return numerator * reciprocal<6>(denominator, 135135, 4024423);
+        }
+
+        static SampleType apply(SampleType x) { return apply(Vector::expand(x)).get(0); }
+    };
+
+private:
+
+    // 1 / d, for d from minimum to maximum, with multiplications only.
+    //
+    // The first guess is the straight line that is closest to 1 / d over the range, in relative error. Then each
+    // Newton-Raphson iteration r = r * (2 - d * r) squares the relative error, e.g. 0.2 -> 0.04 -> 0.0016 -> ...
+    template <int NumIterations>
+    static Vector reciprocal(Vector d, SampleType minimum, SampleType maximum)
+    {
+        const SampleType slope = 8 / ((minimum + maximum) * (minimum + maximum) + 4 * minimum * maximum);
+
+        Vector r = Vector::expand(slope * (minimum + maximum)) - d * Vector::expand(slope);
+
+        for (int i = 0; i < NumIterations; ++i)
+            r = r * (Vector::expand(2) - d * r);
+
+        return r;
+    }
+
+    // std::tanh can't be vectorised, so it's called for each element of the register
+    struct ExactTanh
+    {
+        static Vector apply(Vector x)
+        {
+            for (size_t i = 0; i < Vector::SIMDNumElements; ++i)
+                x.set(i, std::tanh(x.get(i)));
+
+            return x;
+        }
+
+        static SampleType apply(SampleType x) { return std::tanh(x); }
+    };
+
+    template <typename Tanh>
+    static SampleType processSample(SampleType x, SampleType gain, SampleType inverseGain)
+    {
+        return Tanh::apply(x * gain) * inverseGain;
+    }
+
+    template <typename Tanh>
+    void processBlock(const dsp::AudioBlock<SampleType>& block)
+    {
+        const int numChannels = (int) block.getNumChannels();
+        const int numSamples = (int) block.getNumSamples();
+
+        if (!drive.isSmoothing())
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+                processChannel<Tanh>(block.getChannelPointer((size_t) ch), numSamples, drive.getTargetValue(), compensation.getTargetValue());
+
+            return;
+        }
+
+        // While ramping, every sample has its own gain. The gains are computed for a short chunk at a time into
+        // arrays on the stack, and the same gains are used for every channel.
+        SampleType rampGains[rampChunkSize];
+        SampleType rampInverseGains[rampChunkSize];
+
+        for (int start = 0; start < numSamples; start += rampChunkSize)
+        {
+            const int numInChunk = jmin(rampChunkSize, numSamples - start);
+
+            for (int i = 0; i < numInChunk; ++i)
+            {
+                rampGains[i] = drive.getNextValue();
+                rampInverseGains[i] = compensation.getNextValue();
+            }
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                SampleType* data = block.getChannelPointer((size_t) ch) + start;
+
+                for (int i = 0; i < numInChunk; ++i)
+                    data[i] = processSample<Tanh>(data[i], rampGains[i], rampInverseGains[i]);
+            }
+        }
+    }
+
+    // The start and the end of the channel may not be aligned to the SIMD registers. Those few samples are processed
+    // one by one, but still through a register, so that every sample gets exactly the same result.
+    template <typename Tanh>
+    static void processChannel(SampleType* data, int numSamples, SampleType gain, SampleType inverseGain)
+    {
+        const int numUnaligned = jmin(numSamples, (int) (Vector::getNextSIMDAlignedPtr(data) - data));
+        int i = 0;
+
+        for (; i < numUnaligned; ++i)
+            data[i] = processSample<Tanh>(data[i], gain, inverseGain);
+
+        const Vector gainVector = Vector::expand(gain);
+        const Vector inverseGainVector = Vector::expand(inverseGain);
+
+        for (; i + (int) Vector::SIMDNumElements <= numSamples; i += (int) Vector::SIMDNumElements)
+            (Tanh::apply(Vector::fromRawArray(data + i) * gainVector) * inverseGainVector).copyToRawArray(data + i);
+
+        for (; i < numSamples; ++i)
+            data[i] = processSample<Tanh>(data[i], gain, inverseGain);
+    }
+
+    static constexpr double rampLengthSeconds = 0.05;
+    static constexpr int rampChunkSize = 64;
+
+    Approximation approximation = Approximation::accurate;
+
+    SmoothedValue<SampleType, ValueSmoothingTypes::Multiplicative> drive { 1 };
+    SmoothedValue<SampleType, ValueSmoothingTypes::Multiplicative> compensation { 1 };
+};